@@ -0,0 +1,111 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <random>       // mt19937, uniform_int_distribution
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+#include "counting_r_tree.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Число вставок и запросов
+static const int kSizeDataset = 200000;
+static const int kQueryCount = 10000;
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+// Вывод: <данные>\t<площадь>\t<время вставок, нс>\t<перекрытие соседей>\t<узлов на запрос>\t<записей листьев на запрос>\t<время запроса, нс>
+template <typename AREA>
+static void measure(const char* a_dataset, const char* a_name, const vector<Rect>& a_rects, const vector<Rect>& a_queries) {
+  CountingRTree<BasicRTree<int, Rect, AREA>> r_tree;
+
+  auto time_point_before = chrono::steady_clock::now();
+  for (int i = 0; i < kSizeDataset; i++) {
+    r_tree.Insert(a_rects[static_cast<size_t>(i)].m_min, a_rects[static_cast<size_t>(i)].m_max, i + 1);
+  }
+  auto time_point_after = chrono::steady_clock::now();
+  long long time_elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+
+  typename CountingRTree<BasicRTree<int, Rect, AREA>>::Visited visited;
+  for (const auto& query : a_queries) {
+    r_tree.Visit(query, visited);
+  }
+
+  int found = 0;
+  time_point_before = chrono::steady_clock::now();
+  for (const auto& query : a_queries) {
+    r_tree.Search(query.m_min, query.m_max, count_result, &found);
+  }
+  time_point_after = chrono::steady_clock::now();
+  long long query_ns = chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count() / kQueryCount;
+
+  cout << a_dataset << "\t" << a_name << "\t" << time_elapsed_ns << "\t" << r_tree.SiblingOverlap() << "\t"
+       << static_cast<double>(visited.nodes) / kQueryCount << "\t" << static_cast<double>(visited.entries) / kQueryCount << "\t" << query_ns << "\n";
+}
+
+int main() {
+  // Прямоугольники до 1000 x 1000 в квадрате 1e6 x 1e6: площади узлов до 1e12, больше точности float
+  mt19937 engine(2021);
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  uniform_int_distribution<int> side(0, 1000);
+  vector<Rect> rects;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    rects.emplace_back(x_min, y_min, x_min + side(engine), y_min + side(engine));
+  }
+  vector<Rect> queries;
+  for (int i = 0; i < kQueryCount; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    queries.emplace_back(x_min, y_min, x_min + 5000, y_min + 5000);
+  }
+
+  measure<float>("uniform", "float", rects, queries);
+  measure<ExactArea>("uniform", "exact", rects, queries);
+
+  // Точки в 16 плотных кластерах радиуса 100 по всей области int и 10% выбросов по всей области.
+  // Листья с выбросами имеют стороны ~1e9 и площади ~1e18, а точка у края кластера расширяет их
+  // на величину меньше шага float: float видит ничью и выбирает поддерево по меньшей площади,
+  // а группу сплита - по числу записей, хотя точная площадь различает варианты
+  const int kClusters = 16;
+  const int kRadius = 100;
+  uniform_int_distribution<int> wide(-2000000000, 2000000000);
+  uniform_int_distribution<int> offset(-kRadius, kRadius);
+  uniform_int_distribution<int> cluster(0, kClusters - 1);
+  uniform_int_distribution<int> percent(0, 99);
+  vector<int> centers;
+  for (int i = 0; i < 2 * kClusters; i++) {
+    centers.push_back(wide(engine) / 2);
+  }
+  vector<Rect> points;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x;
+    int y;
+    if (percent(engine) < 10) {
+      x = wide(engine);
+      y = wide(engine);
+    } else {
+      int index = cluster(engine);
+      x = centers[static_cast<size_t>(2 * index)] + offset(engine);
+      y = centers[static_cast<size_t>(2 * index + 1)] + offset(engine);
+    }
+    points.emplace_back(x, y, x, y);
+  }
+  vector<Rect> cluster_queries;
+  for (int i = 0; i < kQueryCount; i++) {
+    int index = cluster(engine);
+    int x_min = centers[static_cast<size_t>(2 * index)] + offset(engine);
+    int y_min = centers[static_cast<size_t>(2 * index + 1)] + offset(engine);
+    cluster_queries.emplace_back(x_min, y_min, x_min + 20, y_min + 20);
+  }
+
+  measure<float>("clustered", "float", points, cluster_queries);
+  measure<ExactArea>("clustered", "exact", points, cluster_queries);
+  return 0;
+}
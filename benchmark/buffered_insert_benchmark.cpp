@@ -0,0 +1,136 @@
+#include <algorithm>    // min
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <random>       // mt19937, uniform_int_distribution
+#include <string>
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+#include "buffered_r_tree.hpp"
+#include "counting_r_tree.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Число вставок в потоке записи и запросов после слияния буфера
+static const int kSizeDataset = 200000;
+static const int kQueryCount = 1000;
+
+// Размеры буфера; 0 - вставки сразу в RTree
+static const int kCapacities[] = {0, 1000, 10000, 50000};
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+template <typename TREE>
+static long long measure_ingest(TREE& a_tree, const vector<RTree::Rect>& a_rects) {
+  auto time_point_before = chrono::steady_clock::now();
+  for (int i = 0; i < kSizeDataset; i++) {
+    a_tree.Insert(a_rects[static_cast<size_t>(i)].m_min, a_rects[static_cast<size_t>(i)].m_max, i + 1);
+    // каждая десятая запись удаляется сразу после вставки предыдущей
+    if (i % 10 == 9) {
+      a_tree.Remove(a_rects[static_cast<size_t>(i - 1)].m_min, a_rects[static_cast<size_t>(i - 1)].m_max, i);
+    }
+  }
+  auto time_point_after = chrono::steady_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+}
+
+// Среднее время запроса, нс; в a_found - число найденных записей
+template <typename TREE>
+static long long measure_queries(TREE& a_tree, const vector<RTree::Rect>& a_queries, int& a_found) {
+  auto time_point_before = chrono::steady_clock::now();
+  for (const auto& query : a_queries) {
+    a_tree.Search(query.m_min, query.m_max, count_result, &a_found);
+  }
+  auto time_point_after = chrono::steady_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count() / kQueryCount;
+}
+
+// Форма дерева после построения одним из способов:
+// <политика>\t<способ>\t<листьев на запрос>\t<записей листьев на запрос>\t<среднее время запроса, нс>
+static void measure_shape(const char* a_policy, const char* a_name, CountingRTree<RTree>& a_tree, const vector<RTree::Rect>& a_queries) {
+  CountingRTree<RTree>::Visited visited;
+  for (const auto& query : a_queries) {
+    a_tree.Visit(query, visited);
+  }
+  int found = 0;
+  long long query_ns = measure_queries(a_tree, a_queries, found);
+  cout << a_policy << "\t" << a_name << "\t" << static_cast<double>(visited.leaves) / kQueryCount << "\t"
+       << static_cast<double>(visited.entries) / kQueryCount << "\t" << query_ns << "\n";
+}
+
+int main() {
+  // Квадраты 100 x 100 с равномерно распределенным углом в области 1e6 x 1e6
+  mt19937 engine(2021);
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  vector<RTree::Rect> rects;
+  vector<int> ids;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    rects.emplace_back(x_min, y_min, x_min + 100, y_min + 100);
+    ids.push_back(i + 1);
+  }
+  vector<RTree::Rect> queries;
+  for (int i = 0; i < kQueryCount; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    queries.emplace_back(x_min, y_min, x_min + 10000, y_min + 10000);
+  }
+
+  // Вывод: <политика>\t<буфер>\t<время потока записи, нс>\t<нс на операцию>\t<время запроса после слияния, нс>\t<найдено>
+  for (auto policy : {SplitPolicy::kQuadratic, SplitPolicy::kHilbert}) {
+    for (int capacity : kCapacities) {
+      long long time_elapsed_ns;
+      long long query_ns;
+      int found = 0;
+      if (capacity == 0) {
+        RTree r_tree(policy);
+        time_elapsed_ns = measure_ingest(r_tree, rects);
+        query_ns = measure_queries(r_tree, queries, found);
+      } else {
+        BufferedRTree<int> r_tree(capacity, policy);
+        time_elapsed_ns = measure_ingest(r_tree, rects);
+        r_tree.Flush();
+        query_ns = measure_queries(r_tree, queries, found);
+      }
+
+      int operations = kSizeDataset + kSizeDataset / 10;
+      cout << (policy == SplitPolicy::kHilbert ? "hilbert" : "quadratic") << "\t" << capacity << "\t"
+           << time_elapsed_ns << "\t" << time_elapsed_ns / operations << "\t" << query_ns << "\t" << found << "\n";
+    }
+  }
+
+  // Форма дерева: вставки по одной, BulkLoad и пачки BulkInsert размером с буфер (как при Flush)
+  for (auto policy : {SplitPolicy::kQuadratic, SplitPolicy::kHilbert}) {
+    const char* name = policy == SplitPolicy::kHilbert ? "hilbert" : "quadratic";
+
+    CountingRTree<RTree> inserted(policy);
+    for (int i = 0; i < kSizeDataset; i++) {
+      inserted.Insert(rects[static_cast<size_t>(i)].m_min, rects[static_cast<size_t>(i)].m_max, ids[static_cast<size_t>(i)]);
+    }
+    measure_shape(name, "insert", inserted, queries);
+
+    CountingRTree<RTree> loaded(policy);
+    loaded.BulkLoad(rects.data(), ids.data(), kSizeDataset, 1);
+    measure_shape(name, "bulk_load", loaded, queries);
+
+    for (int capacity : kCapacities) {
+      if (capacity == 0) {
+        continue;
+      }
+      CountingRTree<RTree> merged(policy);
+      for (int first = 0; first < kSizeDataset; first += capacity) {
+        int count = min(capacity, kSizeDataset - first);
+        merged.BulkInsert(&rects[static_cast<size_t>(first)], &ids[static_cast<size_t>(first)], count, 1);
+      }
+      string label = "bulk_insert_" + to_string(capacity);
+      measure_shape(name, label.c_str(), merged, queries);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <random>       // mt19937, uniform_int_distribution
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+
+using namespace std;
+using namespace itis;
+
+// 1000000 - размер самого большого набора данных
+static const int kSizeDataset = 1000000;
+
+// Число потоков, на которых проверяется масштабирование
+static const int kThreadCounts[] = {1, 2, 4, 8, 16};
+
+int main() {
+  // Данные с тем же распределением, что и в dataset/generate_csv_dataset.py
+  mt19937 engine(2021);
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  vector<RTree::Rect> rects;
+  vector<int> ids;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    rects.emplace_back(x_min, y_min, uniform_int_distribution<int>(x_min + 1, 1000000)(engine),
+                       uniform_int_distribution<int>(y_min, 1000000)(engine));
+    ids.push_back(i + 1);
+  }
+
+  // Вывод: <политика>\t<потоки>\t<время построения, нс>
+  for (auto policy : {SplitPolicy::kQuadratic, SplitPolicy::kHilbert}) {
+    for (int threads : kThreadCounts) {
+      RTree r_tree(policy);
+
+      auto time_point_before = chrono::steady_clock::now();
+      r_tree.BulkLoad(rects.data(), ids.data(), kSizeDataset, threads);
+      auto time_point_after = chrono::steady_clock::now();
+      auto time_diff = time_point_after - time_point_before;
+      long long time_elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(time_diff).count();
+
+      cout << (policy == SplitPolicy::kHilbert ? "hilbert" : "str") << "\t" << threads << "\t" << time_elapsed_ns
+           << "\n";
+    }
+  }
+  return 0;
+}
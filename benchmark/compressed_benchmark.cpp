@@ -0,0 +1,74 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <random>       // mt19937, uniform_int_distribution
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+#include "compressed_r_tree.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Число записей и запросов
+static const int kSizeDataset = 1000000;
+static const int kQueryCount = 100000;
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+// Вывод: <представление>\t<байт на запись>\t<из них поправки>\t<среднее время запроса, нс>\t<найдено>
+template <typename TREE>
+static void measure(const char* a_name, TREE& a_tree, double a_bytes, double a_exact, const vector<RTree::Rect>& a_queries) {
+  int found = 0;
+
+  auto time_point_before = chrono::steady_clock::now();
+  for (const auto& query : a_queries) {
+    a_tree.Search(query.m_min, query.m_max, count_result, &found);
+  }
+  auto time_point_after = chrono::steady_clock::now();
+  long long time_elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+
+  cout << a_name << "\t" << a_bytes / kSizeDataset << "\t" << a_exact / kSizeDataset << "\t"
+       << time_elapsed_ns / kQueryCount << "\t" << found << "\n";
+}
+
+template <typename OFFSET>
+static void measure_compressed(const char* a_name, const RTree& a_tree, bool a_keepExact, const vector<RTree::Rect>& a_queries) {
+  CompressedRTree<OFFSET> compressed(a_tree, a_keepExact);
+  measure(a_name, compressed, static_cast<double>(compressed.CompressedSize()), static_cast<double>(compressed.ExactSize()), a_queries);
+}
+
+int main() {
+  // Квадраты 100 x 100 с равномерно распределенным углом в области 1e6 x 1e6
+  mt19937 engine(2021);
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  vector<RTree::Rect> rects;
+  vector<int> ids;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    rects.emplace_back(x_min, y_min, x_min + 100, y_min + 100);
+    ids.push_back(i + 1);
+  }
+  vector<RTree::Rect> queries;
+  for (int i = 0; i < kQueryCount; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    queries.emplace_back(x_min, y_min, x_min + 1000, y_min + 1000);
+  }
+
+  RTree r_tree;
+  r_tree.BulkLoad(rects.data(), ids.data(), kSizeDataset);
+
+  // Для обычного дерева - только записи листьев (прямоугольник и id), без внутренних узлов и незаполненных мест
+  measure("rtree", r_tree, static_cast<double>(kSizeDataset) * (sizeof(RTree::Rect) + sizeof(int)), 0, queries);
+  measure_compressed<uint16_t>("compressed16", r_tree, true, queries);
+  measure_compressed<uint8_t>("compressed8", r_tree, true, queries);
+  // Без поправок Search возвращает кандидатов, поэтому найдено больше
+  measure_compressed<uint16_t>("candidates16", r_tree, false, queries);
+  measure_compressed<uint8_t>("candidates8", r_tree, false, queries);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <algorithm>    // min, max
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+
+// Дерево, которое считает посещенные при поиске узлы, листья и проверенные в них записи
+// (обход повторяет BasicRTree::Search). TREE - любой вариант BasicRTree с прямоугольниками в листьях
+template <typename TREE>
+struct CountingRTree : TREE {
+  using Rect = itis::Rect;
+  using NodeBase = typename TREE::NodeBase;
+
+  using TREE::TREE;
+
+  // Счетчики обхода, накапливаются по всем запросам
+  struct Visited {
+    long long nodes = 0;
+    long long leaves = 0;
+    long long entries = 0;
+  };
+
+  void Visit(const Rect& a_query, Visited& a_visited) {
+    Visit(this->root, a_query, a_visited);
+  }
+
+  // Доля площади детей внутренних узлов, которая приходится на попарные пересечения соседей
+  double SiblingOverlap() {
+    double overlap = 0;
+    double area = 0;
+    SiblingOverlap(this->root, overlap, area);
+    return area > 0 ? overlap / area : 0;
+  }
+
+  static void Visit(NodeBase* a_node, const Rect& a_query, Visited& a_visited) {
+    a_visited.nodes++;
+    if (a_node->IsInternalNode()) {
+      auto* node = TREE::AsInternal(a_node);
+      for (int index = 0; index < node->m_count; index++) {
+        if (itis::Overlap(a_query, node->m_branch[index].m_rect)) {
+          Visit(node->m_branch[index].m_child, a_query, a_visited);
+        }
+      }
+    } else {
+      a_visited.leaves++;
+      a_visited.entries += a_node->m_count;
+    }
+  }
+
+  static double Side(int a_min, int a_max) {
+    return static_cast<double>(a_max) - a_min;
+  }
+
+  static void SiblingOverlap(NodeBase* a_node, double& a_overlap, double& a_area) {
+    if (!a_node->IsInternalNode()) {
+      return;
+    }
+    auto* node = TREE::AsInternal(a_node);
+    for (int first = 0; first < node->m_count; first++) {
+      const Rect& rect = node->m_branch[first].m_rect;
+      a_area += Side(rect.m_min[0], rect.m_max[0]) * Side(rect.m_min[1], rect.m_max[1]);
+      for (int second = first + 1; second < node->m_count; second++) {
+        const Rect& other = node->m_branch[second].m_rect;
+        double width = Side(std::max(rect.m_min[0], other.m_min[0]), std::min(rect.m_max[0], other.m_max[0]));
+        double height = Side(std::max(rect.m_min[1], other.m_min[1]), std::min(rect.m_max[1], other.m_max[1]));
+        if (width > 0 && height > 0) {
+          a_overlap += width * height;
+        }
+      }
+      SiblingOverlap(node->m_branch[first].m_child, a_overlap, a_area);
+    }
+  }
+};
@@ -0,0 +1,126 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <random>       // mt19937, uniform_int_distribution
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Размеры наборов и параметры запросов
+static const int kSizeDataset = 1000000;
+static const int kJoinSize = 200000;
+static const int kQueryCount = 10000;
+static const int kRadius = 2000;
+static const int kJoinDistance = 200;
+
+// Эмуляция поиска по расстоянию: прямоугольный поиск и точная проверка в callback
+struct RadiusFilter {
+  const vector<RTree::Rect>* rects;
+  long long center[dimensions];
+  long long radius;
+  int found;
+};
+
+static bool filter_result(int a_data, void* a_context) {
+  auto* filter = static_cast<RadiusFilter*>(a_context);
+  const RTree::Rect& rect = (*filter->rects)[static_cast<size_t>(a_data)];
+  long long dx = rect.m_min[0] - filter->center[0];
+  long long dy = rect.m_min[1] - filter->center[1];
+  if (dx * dx + dy * dy <= filter->radius * filter->radius) {
+    ++filter->found;
+  }
+  return true;
+}
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+static bool count_pair(int, int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+static vector<RTree::Rect> make_points(mt19937& a_engine, int a_count) {
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  vector<RTree::Rect> points;
+  for (int i = 0; i < a_count; i++) {
+    int x = coord(a_engine);
+    int y = coord(a_engine);
+    points.emplace_back(x, y, x, y);
+  }
+  return points;
+}
+
+template <typename TASK>
+static long long measure_ns(TASK a_task) {
+  auto time_point_before = chrono::steady_clock::now();
+  a_task();
+  auto time_point_after = chrono::steady_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+}
+
+int main() {
+  mt19937 engine(2021);
+  vector<RTree::Rect> points = make_points(engine, kSizeDataset);
+  vector<int> ids;
+  for (int i = 0; i < kSizeDataset; i++) {
+    ids.push_back(i);
+  }
+  vector<RTree::Rect> centers = make_points(engine, kQueryCount);
+
+  RTree r_tree;
+  r_tree.BulkLoad(points.data(), ids.data(), kSizeDataset);
+
+  // Вывод: <способ>\t<время, нс>\t<найдено>
+  int found = 0;
+  long long time_elapsed_ns = measure_ns([&]() {
+    for (const auto& center : centers) {
+      RadiusFilter filter{&points, {center.m_min[0], center.m_min[1]}, kRadius, 0};
+      int query_min[dimensions] = {center.m_min[0] - kRadius, center.m_min[1] - kRadius};
+      int query_max[dimensions] = {center.m_min[0] + kRadius, center.m_min[1] + kRadius};
+      r_tree.Search(query_min, query_max, filter_result, &filter);
+      found += filter.found;
+    }
+  });
+  cout << "radius_bbox_filter\t" << time_elapsed_ns << "\t" << found << "\n";
+
+  found = 0;
+  time_elapsed_ns = measure_ns([&]() {
+    for (const auto& center : centers) {
+      r_tree.SearchRadius(center.m_min, kRadius, count_result, &found);
+    }
+  });
+  cout << "radius_native\t" << time_elapsed_ns << "\t" << found << "\n";
+
+  // Соединение двух наборов точек
+  vector<RTree::Rect> left_points = make_points(engine, kJoinSize);
+  vector<RTree::Rect> right_points = make_points(engine, kJoinSize);
+  RTree left_tree;
+  RTree right_tree;
+  left_tree.BulkLoad(left_points.data(), ids.data(), kJoinSize);
+  right_tree.BulkLoad(right_points.data(), ids.data(), kJoinSize);
+
+  found = 0;
+  time_elapsed_ns = measure_ns([&]() {
+    for (const auto& point : left_points) {
+      RadiusFilter filter{&right_points, {point.m_min[0], point.m_min[1]}, kJoinDistance, 0};
+      int query_min[dimensions] = {point.m_min[0] - kJoinDistance, point.m_min[1] - kJoinDistance};
+      int query_max[dimensions] = {point.m_min[0] + kJoinDistance, point.m_min[1] + kJoinDistance};
+      right_tree.Search(query_min, query_max, filter_result, &filter);
+      found += filter.found;
+    }
+  });
+  cout << "join_bbox_filter\t" << time_elapsed_ns << "\t" << found << "\n";
+
+  found = 0;
+  time_elapsed_ns = measure_ns([&]() {
+    left_tree.DistanceJoin(right_tree, kJoinDistance, count_pair, &found);
+  });
+  cout << "join_native\t" << time_elapsed_ns << "\t" << found << "\n";
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <cstdio>       // fopen, remove
+#include <random>       // mt19937, uniform_int_distribution
+#include <string>
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "durable_r_tree.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Файлы индекса создаются в текущей папке
+static const string kPath = "durable_benchmark";
+
+// Размер индекса, число вставок для сравнения политик fsync и длины хвостов журнала
+static const int kSizeDataset = 1000000;
+static const int kPolicyInserts = 10000;
+static const int kTails[] = {1000, 10000, 100000};
+
+// Прямоугольники со сторонами до 100 в квадрате [0, a_area]
+static vector<RTree::Rect> make_rects(int a_count, int a_area, mt19937& a_engine) {
+  uniform_int_distribution<int> coord(0, a_area - 100);
+  uniform_int_distribution<int> side(1, 100);
+  vector<RTree::Rect> rects;
+  for (int i = 0; i < a_count; i++) {
+    int x_min = coord(a_engine);
+    int y_min = coord(a_engine);
+    int width = side(a_engine);
+    rects.emplace_back(x_min, y_min, x_min + width, y_min + side(a_engine));
+  }
+  return rects;
+}
+
+static void remove_files() {
+  remove((kPath + ".pages").c_str());
+  remove((kPath + ".wal").c_str());
+}
+
+static uint64_t pages_size() {
+  uint64_t size = 0;
+  FILE* file = fopen((kPath + ".pages").c_str(), "rb");
+  if (file) {
+    DurableSize(file, size);
+    fclose(file);
+  }
+  return size;
+}
+
+template <typename ACTION>
+static long long measure(ACTION a_action) {
+  auto time_point_before = chrono::steady_clock::now();
+  a_action();
+  auto time_point_after = chrono::steady_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+}
+
+int main() {
+  mt19937 engine(2021);
+  vector<RTree::Rect> rects = make_rects(kSizeDataset, 1000000, engine);
+
+  // Вставки при разных политиках fsync: <политика>\t<вставок>\t<время, нс>
+  const char* names[] = {"always", "group", "never"};
+  for (FsyncPolicy fsync : {FsyncPolicy::kAlways, FsyncPolicy::kGroup, FsyncPolicy::kNever}) {
+    remove_files();
+    DurableRTree<int> tree(kPath, fsync, 64, 0, SplitPolicy::kHilbert);
+    long long time_ns = measure([&] {
+      for (int i = 0; i < kPolicyInserts; i++) {
+        tree.Insert(rects[static_cast<size_t>(i)].m_min, rects[static_cast<size_t>(i)].m_max, i + 1);
+      }
+      tree.Commit();
+    });
+    cout << names[static_cast<int>(fsync)] << "\t" << kPolicyInserts << "\t" << time_ns << "\n";
+  }
+
+  // Первое (полное) сохранение индекса и открытие с хвостом журнала из N изменений:
+  // checkpoint\t0\t<время, нс>\t<прирост файла страниц, байт>
+  // recovery\t<изменений>\t<время, нс>\t<прирост файла страниц, байт>
+  remove_files();
+  {
+    DurableRTree<int> tree(kPath, FsyncPolicy::kNever, 64, 0, SplitPolicy::kHilbert);
+    for (int i = 0; i < kSizeDataset; i++) {
+      tree.Insert(rects[static_cast<size_t>(i)].m_min, rects[static_cast<size_t>(i)].m_max, i + 1);
+    }
+    uint64_t size_before = pages_size();
+    long long time_ns = measure([&] { tree.Checkpoint(); });
+    cout << "checkpoint\t0\t" << time_ns << "\t" << pages_size() - size_before << "\n";
+  }
+
+  int next_id = kSizeDataset + 1;
+  for (int tail : kTails) {
+    // Изменения сосредоточены в 1% области: меняется мало листьев, и контрольная точка пишет только их
+    vector<RTree::Rect> updates = make_rects(tail, 100000, engine);
+    {
+      DurableRTree<int> tree(kPath, FsyncPolicy::kNever, 64, 0);
+      for (int i = 0; i < tail; i++) {
+        tree.Insert(updates[static_cast<size_t>(i)].m_min, updates[static_cast<size_t>(i)].m_max, next_id++);
+      }
+      tree.Commit();
+    }
+
+    // Восстановление проигрывает хвост и сразу сохраняет его контрольной точкой
+    uint64_t size_before = pages_size();
+    long long time_ns = measure([&] { DurableRTree<int> tree(kPath); });
+    cout << "recovery\t" << tail << "\t" << time_ns << "\t" << pages_size() - size_before << "\n";
+  }
+  remove_files();
+  return 0;
+}
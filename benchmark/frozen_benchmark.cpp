@@ -0,0 +1,138 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <cstdint>      // uint64_t
+#include <random>       // mt19937, uniform_int_distribution
+#include <vector>
+
+#if defined(__linux__)
+#include <cstring>      // memset
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+#include "frozen_r_tree.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Число записей и запросов
+static const int kSizeDataset = 1000000;
+static const int kQueryCount = 100000;
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+// Счетчик промахов кэша последнего уровня (perf_event_open, только Linux).
+// Если счетчик недоступен (нет прав или виртуальная машина), Read возвращает -1
+struct CacheMissCounter {
+  int fd = -1;
+
+  CacheMissCounter() {
+#if defined(__linux__)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~CacheMissCounter() {
+#if defined(__linux__)
+    if (fd >= 0) {
+      close(fd);
+    }
+#endif
+  }
+
+  void Start() {
+#if defined(__linux__)
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  long long Read() {
+#if defined(__linux__)
+    uint64_t count = 0;
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) == static_cast<ssize_t>(sizeof(count))) {
+        return static_cast<long long>(count);
+      }
+    }
+#endif
+    return -1;
+  }
+};
+
+// Вывод: <раскладка>\t<среднее время запроса, нс>\t<промахов кэша на запрос>\t<найдено>
+template <typename TREE>
+static void measure(const char* a_name, const TREE& a_tree, const vector<RTree::Rect>& a_queries) {
+  CacheMissCounter counter;
+  int found = 0;
+
+  counter.Start();
+  auto time_point_before = chrono::steady_clock::now();
+  for (const auto& query : a_queries) {
+    a_tree.Search(query.m_min, query.m_max, count_result, &found);
+  }
+  auto time_point_after = chrono::steady_clock::now();
+  long long misses = counter.Read();
+  long long time_elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+
+  cout << a_name << "\t" << time_elapsed_ns / kQueryCount << "\t"
+       << (misses < 0 ? -1.0 : static_cast<double>(misses) / kQueryCount) << "\t" << found << "\n";
+}
+
+// RTree::Search не const, поэтому запросы к нему идут через эту обертку
+struct PointerLayout {
+  RTree& r_tree;
+
+  int Search(const int* a_min, const int* a_max, bool a_resultCallback(int, void*), void* a_context) const {
+    return r_tree.Search(a_min, a_max, a_resultCallback, a_context);
+  }
+};
+
+int main() {
+  // Равномерно разбросанные квадраты 100 x 100 в области 1e6 x 1e6
+  mt19937 engine(2021);
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  vector<RTree::Rect> rects;
+  vector<int> ids;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    rects.emplace_back(x_min, y_min, x_min + 100, y_min + 100);
+    ids.push_back(i + 1);
+  }
+  vector<RTree::Rect> queries;
+  for (int i = 0; i < kQueryCount; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    queries.emplace_back(x_min, y_min, x_min + 1000, y_min + 1000);
+  }
+
+  for (auto policy : {SplitPolicy::kQuadratic, SplitPolicy::kHilbert}) {
+    RTree r_tree(policy);
+    r_tree.BulkLoad(rects.data(), ids.data(), kSizeDataset);
+    FrozenRTree<int> frozen = Freeze(r_tree);
+
+    cout << (policy == SplitPolicy::kHilbert ? "hilbert" : "str") << "\n";
+    measure("pointers", PointerLayout{r_tree}, queries);
+    measure("frozen", frozen, queries);
+  }
+  return 0;
+}
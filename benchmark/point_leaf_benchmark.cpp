@@ -0,0 +1,61 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <random>       // mt19937, uniform_int_distribution
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Число точек и запросов
+static const int kSizeDataset = 1000000;
+static const int kQueryCount = 2000;
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+// Вывод: <дерево>\t<байт на запись листа>\t<время запросов, нс>\t<найдено>
+template <typename TREE, typename GEOMETRY>
+static void measure(const char* a_name, const vector<RTree::Rect>& a_points, const vector<int>& a_ids,
+                    const vector<RTree::Rect>& a_queries) {
+  TREE r_tree;
+  r_tree.BulkLoad(a_points.data(), a_ids.data(), kSizeDataset, 1);
+
+  int found = 0;
+  auto time_point_before = chrono::steady_clock::now();
+  for (const auto& query : a_queries) {
+    r_tree.Search(query.m_min, query.m_max, count_result, &found);
+  }
+  auto time_point_after = chrono::steady_clock::now();
+  long long time_elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+
+  cout << a_name << "\t" << sizeof(GEOMETRY) + sizeof(int) << "\t" << time_elapsed_ns << "\t" << found << "\n";
+}
+
+int main() {
+  // Точки - вырожденные прямоугольники Rect(x, y, x, y)
+  mt19937 engine(2021);
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  vector<RTree::Rect> points;
+  vector<int> ids;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x = coord(engine);
+    int y = coord(engine);
+    points.emplace_back(x, y, x, y);
+    ids.push_back(i + 1);
+  }
+  vector<RTree::Rect> queries;
+  for (int i = 0; i < kQueryCount; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    queries.emplace_back(x_min, y_min, x_min + 10000, y_min + 10000);
+  }
+
+  measure<RTree, Rect>("rect", points, ids, queries);
+  measure<PointRTree, Point>("point", points, ids, queries);
+  return 0;
+}
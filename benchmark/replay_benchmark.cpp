@@ -0,0 +1,165 @@
+#include <algorithm>    // min, max
+#include <iostream>     // cout, cerr
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <cstdint>
+#include <cstring>      // strcmp
+#include <string>
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+#include "workload.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Воспроизведение набора данных и трасс из dataset/generate_dataset:
+//
+// replay_benchmark [--hilbert] <набор данных> [трасса ...]
+//
+// Набор данных вставляется в RTree по одной записи (частями, поэтому помещаются и наборы
+// в сотни миллионов строк), затем по очереди выполняются трассы. Для каждого этапа выводится
+// <файл>\t<операций>\t<операций в секунду>\t<средняя задержка, нс>\t<p50>\t<p99>\t<p99.9>\t<макс.>\t<найдено>
+
+// Сколько записей читается в память за раз
+static const size_t kChunkSize = 1 << 20;
+
+// Гистограмма задержек: степени двойки, каждая поделена на 16 равных частей (погрешность квантили < 7%)
+struct LatencyHistogram {
+  static const int kSubBuckets = 16;
+
+  vector<long long> buckets = vector<long long>(64 * kSubBuckets, 0);
+  long long count = 0;
+  long long total_ns = 0;
+  long long max_ns = 0;
+
+  static size_t Bucket(long long a_ns) {
+    auto value = static_cast<size_t>(a_ns);
+    if (value < kSubBuckets) {
+      return value;
+    }
+    int power = 4;  // value в [2^power, 2^(power+1))
+    while ((value >> (power + 1)) != 0) {
+      power++;
+    }
+    size_t sub = (value >> (power - 4)) & (kSubBuckets - 1);
+    return static_cast<size_t>(power - 3) * kSubBuckets + sub;
+  }
+
+  // Верхняя граница корзины
+  static long long Upper(size_t a_bucket) {
+    if (a_bucket < kSubBuckets) {
+      return static_cast<long long>(a_bucket);
+    }
+    int power = static_cast<int>(a_bucket / kSubBuckets) + 3;
+    auto sub = static_cast<long long>(a_bucket % kSubBuckets);
+    return ((kSubBuckets + sub + 1) << (power - 4)) - 1;
+  }
+
+  void Add(long long a_ns) {
+    buckets[Bucket(a_ns)]++;
+    count++;
+    total_ns += a_ns;
+    max_ns = max(max_ns, a_ns);
+  }
+
+  long long Percentile(double a_fraction) const {
+    auto rank = static_cast<long long>(a_fraction * static_cast<double>(count));
+    long long seen = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); bucket++) {
+      seen += buckets[bucket];
+      if (seen > rank) {
+        return min(Upper(bucket), max_ns);
+      }
+    }
+    return max_ns;
+  }
+};
+
+static bool CountResult(int /*id*/, void* /*arg*/) {
+  return true;
+}
+
+// Выполняет записи трассы, замеряя каждую операцию. Возвращает число найденных при поиске записей
+static long long replay(RTree& a_tree, const vector<WorkloadRecord>& a_records, LatencyHistogram& a_latency) {
+  long long hits = 0;
+  for (const WorkloadRecord& record : a_records) {
+    auto time_point_before = chrono::steady_clock::now();
+    switch (record.m_op) {
+      case WorkloadOp::kInsert:
+        a_tree.Insert(record.m_rect.m_min, record.m_rect.m_max, record.m_id);
+        break;
+      case WorkloadOp::kRemove:
+        a_tree.Remove(record.m_rect.m_min, record.m_rect.m_max, record.m_id);
+        break;
+      case WorkloadOp::kSearch:
+        hits += a_tree.Search(record.m_rect.m_min, record.m_rect.m_max, CountResult, nullptr);
+        break;
+    }
+    auto time_point_after = chrono::steady_clock::now();
+    a_latency.Add(chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count());
+  }
+  return hits;
+}
+
+static void report(const string& a_name, const LatencyHistogram& a_latency, long long a_elapsed_ns, long long a_hits) {
+  double seconds = static_cast<double>(a_elapsed_ns) / 1e9;
+  double throughput = seconds > 0 ? static_cast<double>(a_latency.count) / seconds : 0;
+  long long mean = a_latency.count > 0 ? a_latency.total_ns / a_latency.count : 0;
+  cout << a_name << "\t" << a_latency.count << "\t" << static_cast<long long>(throughput) << "\t" << mean << "\t"
+       << a_latency.Percentile(0.5) << "\t" << a_latency.Percentile(0.99) << "\t" << a_latency.Percentile(0.999) << "\t"
+       << a_latency.max_ns << "\t" << a_hits << "\n";
+}
+
+// Воспроизводит файл частями; время чтения с диска в результат не входит
+static bool replay_file(RTree& a_tree, const string& a_path) {
+  WorkloadReader reader(a_path);
+  if (!reader.IsOpen()) {
+    cerr << "open " << a_path << " error!" << endl;
+    return false;
+  }
+
+  LatencyHistogram latency;
+  long long elapsed_ns = 0;
+  long long hits = 0;
+  vector<WorkloadRecord> records;
+  records.reserve(kChunkSize);
+  while (reader.Read(records, kChunkSize) > 0) {
+    auto time_point_before = chrono::steady_clock::now();
+    hits += replay(a_tree, records, latency);
+    auto time_point_after = chrono::steady_clock::now();
+    elapsed_ns += chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+    records.clear();
+  }
+  if (reader.Failed()) {
+    cerr << "read " << a_path << " error!" << endl;
+    return false;
+  }
+
+  report(a_path, latency, elapsed_ns, hits);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  SplitPolicy policy = SplitPolicy::kQuadratic;
+  vector<string> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--hilbert") == 0) {
+      policy = SplitPolicy::kHilbert;
+    } else {
+      files.emplace_back(argv[i]);
+    }
+  }
+  if (files.empty()) {
+    cerr << "usage: replay_benchmark [--hilbert] <dataset> [trace ...]" << endl;
+    return -1;
+  }
+
+  RTree r_tree(policy);
+  for (const string& file : files) {
+    if (!replay_file(r_tree, file)) {
+      return -1;
+    }
+  }
+  return 0;
+}
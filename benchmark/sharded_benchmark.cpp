@@ -0,0 +1,110 @@
+#include <iostream>     // cout
+#include <chrono>       // steady_clock, duration_cast, nanoseconds
+#include <mutex>        // mutex, lock_guard
+#include <random>       // mt19937, uniform_int_distribution
+#include <thread>       // thread
+#include <vector>
+
+// подключаем вашу структуру данных
+#include "data_structure.hpp"
+#include "sharded_r_tree.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Число записей и запросов
+static const int kSizeDataset = 400000;
+static const int kQueryCount = 2000;
+
+// Число шардов ShardedRTree
+static const int kShardCount = 16;
+
+// Число пишущих/читающих потоков
+static const int kThreadCounts[] = {1, 2, 4, 8, 16};
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+// Одно RTree под общим мьютексом - то, что есть без шардирования
+struct LockedRTree {
+  RTree r_tree{SplitPolicy::kHilbert};
+  mutex lock;
+
+  void Insert(const int* a_min, const int* a_max, int a_data) {
+    lock_guard<mutex> guard(lock);
+    r_tree.Insert(a_min, a_max, a_data);
+  }
+
+  int Search(const int* a_min, const int* a_max, bool a_resultCallback(int, void*), void* a_context) {
+    lock_guard<mutex> guard(lock);
+    return r_tree.Search(a_min, a_max, a_resultCallback, a_context);
+  }
+};
+
+// Делит индексы [0, a_total) между a_threads потоками, возвращает время в нс
+template <typename TASK>
+static long long run_threads(int a_threads, int a_total, TASK a_task) {
+  auto time_point_before = chrono::steady_clock::now();
+  vector<thread> threads;
+  for (int t = 0; t < a_threads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = t; i < a_total; i += a_threads) {
+        a_task(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto time_point_after = chrono::steady_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(time_point_after - time_point_before).count();
+}
+
+template <typename TREE>
+static void measure(const char* a_name, TREE& a_tree, int a_threads, const vector<RTree::Rect>& a_rects,
+                    const vector<RTree::Rect>& a_queries) {
+  long long insert_ns = run_threads(a_threads, kSizeDataset, [&](int i) {
+    a_tree.Insert(a_rects[static_cast<size_t>(i)].m_min, a_rects[static_cast<size_t>(i)].m_max, i + 1);
+  });
+  long long search_ns = run_threads(a_threads, kQueryCount, [&](int i) {
+    int found = 0;
+    a_tree.Search(a_queries[static_cast<size_t>(i)].m_min, a_queries[static_cast<size_t>(i)].m_max, count_result, &found);
+  });
+  cout << a_name << "\t" << a_threads << "\t" << insert_ns << "\t" << search_ns << "\n";
+}
+
+int main() {
+  // Квадраты 100 x 100 с равномерно распределенным углом в области 1e6 x 1e6; разбиение строится по их выборке
+  mt19937 engine(2021);
+  uniform_int_distribution<int> coord(0, 1000000 - 1);
+  vector<RTree::Rect> rects;
+  for (int i = 0; i < kSizeDataset; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    rects.emplace_back(x_min, y_min, x_min + 100, y_min + 100);
+  }
+  vector<RTree::Rect> queries;
+  for (int i = 0; i < kQueryCount; i++) {
+    int x_min = coord(engine);
+    int y_min = coord(engine);
+    queries.emplace_back(x_min, y_min, x_min + 20000, y_min + 20000);
+  }
+
+  // Разбиение выбирается по каждой сотой записи
+  vector<RTree::Rect> sample;
+  for (int i = 0; i < kSizeDataset; i += 100) {
+    sample.push_back(rects[static_cast<size_t>(i)]);
+  }
+
+  // Вывод: <индекс>\t<потоки>\t<время вставок, нс>\t<время запросов, нс>
+  for (int threads : kThreadCounts) {
+    LockedRTree locked;
+    measure("locked", locked, threads, rects, queries);
+
+    ShardedRTree<int> sharded(sample.data(), static_cast<int>(sample.size()), kShardCount, SplitPolicy::kHilbert, 1);
+    measure("sharded", sharded, threads, rects, queries);
+  }
+  return 0;
+}
@@ -0,0 +1,415 @@
+#include <algorithm>    // min, max, upper_bound
+#include <array>
+#include <cmath>        // pow, lround
+#include <cstdint>
+#include <cstring>      // strcmp
+#include <iostream>     // cout, cerr
+#include <random>       // normal_distribution, uniform_int_distribution, bernoulli_distribution
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "workload.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Генератор наборов данных и трасс для replay_benchmark.
+//
+// generate_dataset [--distribution uniform|gaussian|zipf] [--extent large|small|point]
+//                  [--count N] [--queries N] [--updates N] [--format csv|bin] [--output префикс]
+//                  [--seed N] [--world N] [--clusters N] [--sigma N] [--hotspots N] [--zipf S]
+//                  [--hotspot-radius N] [--small-side N] [--query-side N] [--remove-ratio P]
+//
+// Пишет <префикс>.<csv|bin> (вставки записей 1..N), <префикс>_queries.<csv|bin> (поиск) и
+// <префикс>_updates.<csv|bin> (вставки новых и удаления существующих записей).
+// Запись с номером id вычисляется заново из (seed, id), поэтому набор любого размера
+// (100 миллионов строк и больше) пишется потоком, не занимая памяти. Трассе изменений нужна
+// память только под номера, переставленные удалениями (не больше числа удалений)
+
+namespace {
+
+  // Быстрый генератор для std::*_distribution: каждая запись получает свой независимый поток
+  struct SplitMix64
+  {
+    using result_type = uint64_t;
+
+    explicit SplitMix64(uint64_t a_state) : m_state(a_state) {}
+
+    static constexpr result_type min()             { return 0; }
+    static constexpr result_type max()             { return UINT64_MAX; }
+
+    result_type operator()() {
+      uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+    uint64_t m_state;
+  };
+
+  enum class Distribution
+  {
+    kUniform,    // центры равномерно по всей области
+    kGaussian,   // нормальные облака вокруг нескольких центров
+    kZipf,       // горячие точки, популярность которых убывает по закону Ципфа
+  };
+
+  enum class Extent
+  {
+    kLarge,      // стороны до половины области (как в generate_csv_dataset.py)
+    kSmall,      // стороны до small_side
+    kPoint,      // вырожденные прямоугольники (x, y, x, y)
+  };
+
+  struct Options
+  {
+    Distribution distribution = Distribution::kUniform;
+    Extent extent = Extent::kSmall;
+    long long count = 1000000;
+    long long queries = 100000;
+    long long updates = 100000;
+    WorkloadFormat format = WorkloadFormat::kCsv;
+    string output;
+    uint64_t seed = 2021;
+    int world = 1000000;         // координаты в [0, world]
+    int clusters = 16;
+    int sigma = 20000;
+    int hotspots = 1000;
+    double zipf = 1.0;
+    int hotspot_radius = 2000;
+    int small_side = 100;
+    int query_side = 1000;
+    double remove_ratio = 0.5;
+  };
+
+  // Номера потоков случайных чисел: записи набора, центры кластеров, трасса запросов, трасса изменений
+  enum Stream : uint64_t
+  {
+    kRecordStream = 1,
+    kLayoutStream = 2,
+    kQueryStream = 3,
+    kUpdateStream = 4,
+  };
+
+  class Generator
+  {
+   public:
+    explicit Generator(const Options& a_options) : m_options(a_options) {
+      SplitMix64 engine(Seed(kLayoutStream, 0));
+      uniform_int_distribution<int> coord(0, m_options.world);
+
+      int centers = m_options.distribution == Distribution::kGaussian ? m_options.clusters : m_options.hotspots;
+      for (int i = 0; i < max(1, centers); i++) {
+        m_centers.push_back({coord(engine), coord(engine)});
+      }
+
+      // Функция распределения Ципфа: вероятность горячей точки ранга k пропорциональна 1 / k^s
+      if (m_options.distribution == Distribution::kZipf) {
+        double sum = 0;
+        for (size_t rank = 1; rank <= m_centers.size(); rank++) {
+          sum += 1.0 / pow(static_cast<double>(rank), m_options.zipf);
+          m_zipfCdf.push_back(sum);
+        }
+        for (double& value : m_zipfCdf) {
+          value /= sum;
+        }
+      }
+    }
+
+    // Запись набора данных с номером a_id (одинакова при каждом вызове)
+    Rect Record(long long a_id) const {
+      SplitMix64 engine(Seed(kRecordStream, static_cast<uint64_t>(a_id)));
+      int center[dimensions] = {};
+      Place(engine, center);
+      return Shape(engine, center);
+    }
+
+    // Окно поиска: центр из того же распределения, что и данные, сторона query_side
+    Rect Query(SplitMix64& a_engine) const {
+      int center[dimensions] = {};
+      Place(a_engine, center);
+      return Around(center, m_options.query_side, m_options.query_side);
+    }
+
+    uint64_t Seed(uint64_t a_stream, uint64_t a_index) const {
+      SplitMix64 mix(m_options.seed ^ (a_stream << 56) ^ a_index * 0xD1B54A32D192ED03ull);
+      return mix();
+    }
+
+   private:
+    void Place(SplitMix64& a_engine, int a_center[dimensions]) const {
+      switch (m_options.distribution) {
+        case Distribution::kUniform: {
+          uniform_int_distribution<int> coord(0, m_options.world);
+          for (int axis = 0; axis < dimensions; axis++) {
+            a_center[axis] = coord(a_engine);
+          }
+          break;
+        }
+        case Distribution::kGaussian: {
+          const auto& cluster = m_centers[uniform_int_distribution<size_t>(0, m_centers.size() - 1)(a_engine)];
+          normal_distribution<double> offset(0.0, m_options.sigma);
+          for (int axis = 0; axis < dimensions; axis++) {
+            a_center[axis] = Clamp(static_cast<long long>(cluster[static_cast<size_t>(axis)]) + lround(offset(a_engine)));
+          }
+          break;
+        }
+        case Distribution::kZipf: {
+          double u = uniform_real_distribution<double>(0.0, 1.0)(a_engine);
+          auto rank = static_cast<size_t>(upper_bound(m_zipfCdf.begin(), m_zipfCdf.end(), u) - m_zipfCdf.begin());
+          const auto& hotspot = m_centers[min(rank, m_centers.size() - 1)];
+          uniform_int_distribution<int> offset(-m_options.hotspot_radius, m_options.hotspot_radius);
+          for (int axis = 0; axis < dimensions; axis++) {
+            a_center[axis] = Clamp(static_cast<long long>(hotspot[static_cast<size_t>(axis)]) + offset(a_engine));
+          }
+          break;
+        }
+      }
+    }
+
+    Rect Shape(SplitMix64& a_engine, const int a_center[dimensions]) const {
+      switch (m_options.extent) {
+        case Extent::kLarge: {
+          uniform_int_distribution<int> side(0, m_options.world / 2);
+          int width = side(a_engine);
+          return Around(a_center, width, side(a_engine));
+        }
+        case Extent::kSmall: {
+          uniform_int_distribution<int> side(1, max(1, m_options.small_side));
+          int width = side(a_engine);
+          return Around(a_center, width, side(a_engine));
+        }
+        case Extent::kPoint:
+          break;
+      }
+      return Around(a_center, 0, 0);
+    }
+
+    // Прямоугольник со сторонами a_width x a_height вокруг центра, обрезанный границами области
+    Rect Around(const int a_center[dimensions], int a_width, int a_height) const {
+      return Rect(Clamp(static_cast<long long>(a_center[0]) - a_width / 2),
+                  Clamp(static_cast<long long>(a_center[1]) - a_height / 2),
+                  Clamp(static_cast<long long>(a_center[0]) + (a_width - a_width / 2)),
+                  Clamp(static_cast<long long>(a_center[1]) + (a_height - a_height / 2)));
+    }
+
+    int Clamp(long long a_value) const {
+      return static_cast<int>(min<long long>(max<long long>(a_value, 0), m_options.world));
+    }
+
+    const Options& m_options;
+    vector<array<int, dimensions>> m_centers;
+    vector<double> m_zipfCdf;
+  };
+
+  // Живые номера записей как массив, из которого удаляют, ставя на место удаленного последний.
+  // Сам массив не хранится: позиция i по умолчанию содержит номер i + 1, а в таблице лежат
+  // только позиции с другим номером. Вставки подряд идущих номеров таблицу не увеличивают
+  class LiveIds
+  {
+   public:
+    explicit LiveIds(long long a_count) : m_size(a_count) {}
+
+    long long Size() const {
+      return m_size;
+    }
+
+    // Убирает номер с позиции a_index и возвращает его
+    int Take(long long a_index) {
+      int id = At(a_index);
+      long long last = m_size - 1;
+      if (a_index != last) {
+        Set(a_index, At(last));
+      }
+      m_moved.erase(last);
+      m_size--;
+      return id;
+    }
+
+    void Push(int a_id) {
+      Set(m_size, a_id);
+      m_size++;
+    }
+
+   private:
+    int At(long long a_index) const {
+      auto moved = m_moved.find(a_index);
+      return moved == m_moved.end() ? static_cast<int>(a_index + 1) : moved->second;
+    }
+
+    void Set(long long a_index, int a_id) {
+      if (a_id == a_index + 1) {
+        m_moved.erase(a_index);
+      } else {
+        m_moved[a_index] = a_id;
+      }
+    }
+
+    long long m_size;
+    unordered_map<long long, int> m_moved;
+  };
+
+  bool ParseOptions(int argc, char** argv, Options& a_options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+      const char* name = argv[i];
+      string value = argv[i + 1];
+      try {
+        if (strcmp(name, "--distribution") == 0) {
+          if (value == "uniform") {
+            a_options.distribution = Distribution::kUniform;
+          } else if (value == "gaussian") {
+            a_options.distribution = Distribution::kGaussian;
+          } else if (value == "zipf") {
+            a_options.distribution = Distribution::kZipf;
+          } else {
+            return false;
+          }
+        } else if (strcmp(name, "--extent") == 0) {
+          if (value == "large") {
+            a_options.extent = Extent::kLarge;
+          } else if (value == "small") {
+            a_options.extent = Extent::kSmall;
+          } else if (value == "point") {
+            a_options.extent = Extent::kPoint;
+          } else {
+            return false;
+          }
+        } else if (strcmp(name, "--format") == 0) {
+          if (value == "csv") {
+            a_options.format = WorkloadFormat::kCsv;
+          } else if (value == "bin") {
+            a_options.format = WorkloadFormat::kBinary;
+          } else {
+            return false;
+          }
+        } else if (strcmp(name, "--output") == 0) {
+          a_options.output = value;
+        } else if (strcmp(name, "--count") == 0) {
+          a_options.count = stoll(value);
+        } else if (strcmp(name, "--queries") == 0) {
+          a_options.queries = stoll(value);
+        } else if (strcmp(name, "--updates") == 0) {
+          a_options.updates = stoll(value);
+        } else if (strcmp(name, "--seed") == 0) {
+          a_options.seed = stoull(value);
+        } else if (strcmp(name, "--world") == 0) {
+          a_options.world = stoi(value);
+        } else if (strcmp(name, "--clusters") == 0) {
+          a_options.clusters = stoi(value);
+        } else if (strcmp(name, "--sigma") == 0) {
+          a_options.sigma = stoi(value);
+        } else if (strcmp(name, "--hotspots") == 0) {
+          a_options.hotspots = stoi(value);
+        } else if (strcmp(name, "--zipf") == 0) {
+          a_options.zipf = stod(value);
+        } else if (strcmp(name, "--hotspot-radius") == 0) {
+          a_options.hotspot_radius = stoi(value);
+        } else if (strcmp(name, "--small-side") == 0) {
+          a_options.small_side = stoi(value);
+        } else if (strcmp(name, "--query-side") == 0) {
+          a_options.query_side = stoi(value);
+        } else if (strcmp(name, "--remove-ratio") == 0) {
+          a_options.remove_ratio = stod(value);
+        } else {
+          return false;
+        }
+      } catch (const exception&) {
+        return false;
+      }
+    }
+    // Количество записей ограничено идентификатором int
+    return argc % 2 == 1 && a_options.count >= 0 && a_options.queries >= 0 && a_options.updates >= 0 && a_options.count + a_options.updates < INT32_MAX &&
+           a_options.world > 0 && a_options.sigma >= 0 && a_options.hotspot_radius >= 0 && a_options.remove_ratio >= 0 && a_options.remove_ratio <= 1;
+  }
+
+  string DefaultOutput(const Options& a_options) {
+    const char* distributions[] = {"uniform", "gaussian", "zipf"};
+    const char* extents[] = {"large", "small", "point"};
+    return string(PROJECT_DATASET_DIR) + "/" + distributions[static_cast<int>(a_options.distribution)] + "_" +
+           extents[static_cast<int>(a_options.extent)] + "_" + to_string(a_options.count);
+  }
+
+  bool Finish(WorkloadWriter& a_writer, const string& a_path, long long a_count) {
+    if (!a_writer.Close()) {
+      cerr << "write " << a_path << " error!" << endl;
+      return false;
+    }
+    cout << a_path << "\t" << a_count << "\n";
+    return true;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    cerr << "usage: generate_dataset [--distribution uniform|gaussian|zipf] [--extent large|small|point]\n"
+            "                        [--count N] [--queries N] [--updates N] [--format csv|bin] [--output prefix]\n"
+            "                        [--seed N] [--world N] [--clusters N] [--sigma N] [--hotspots N] [--zipf S]\n"
+            "                        [--hotspot-radius N] [--small-side N] [--query-side N] [--remove-ratio P]"
+         << endl;
+    return -1;
+  }
+  string prefix = options.output.empty() ? DefaultOutput(options) : options.output;
+  string extension = options.format == WorkloadFormat::kBinary ? ".bin" : ".csv";
+  Generator generator(options);
+
+  // Набор данных: записи 1..count
+  string path = prefix + extension;
+  WorkloadWriter dataset(path, options.format);
+  if (!dataset.IsOpen()) {
+    cerr << "open " << path << " error!" << endl;
+    return -1;
+  }
+  for (long long id = 1; id <= options.count; id++) {
+    dataset.Write({WorkloadOp::kInsert, static_cast<int>(id), generator.Record(id)});
+  }
+  if (!Finish(dataset, path, options.count)) {
+    return -1;
+  }
+
+  // Трасса запросов
+  path = prefix + "_queries" + extension;
+  WorkloadWriter queries(path, options.format);
+  if (!queries.IsOpen()) {
+    cerr << "open " << path << " error!" << endl;
+    return -1;
+  }
+  SplitMix64 query_engine(generator.Seed(kQueryStream, 0));
+  for (long long i = 0; i < options.queries; i++) {
+    queries.Write({WorkloadOp::kSearch, 0, generator.Query(query_engine)});
+  }
+  if (!Finish(queries, path, options.queries)) {
+    return -1;
+  }
+
+  // Трасса изменений: новые записи получают номера после набора данных,
+  // удаляется случайная живая запись (из набора или вставленная раньше в этой трассе)
+  path = prefix + "_updates" + extension;
+  WorkloadWriter updates(path, options.format);
+  if (!updates.IsOpen()) {
+    cerr << "open " << path << " error!" << endl;
+    return -1;
+  }
+  SplitMix64 update_engine(generator.Seed(kUpdateStream, 0));
+  bernoulli_distribution remove(options.remove_ratio);
+  LiveIds alive(options.count);
+  long long next_id = options.count + 1;
+  for (long long i = 0; i < options.updates; i++) {
+    if (alive.Size() > 0 && remove(update_engine)) {
+      uniform_int_distribution<long long> pick(0, alive.Size() - 1);
+      int id = alive.Take(pick(update_engine));
+      updates.Write({WorkloadOp::kRemove, id, generator.Record(id)});
+    } else {
+      updates.Write({WorkloadOp::kInsert, static_cast<int>(next_id), generator.Record(next_id)});
+      alive.Push(static_cast<int>(next_id));
+      next_id++;
+    }
+  }
+  if (!Finish(updates, path, options.updates)) {
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>     // cout
+
+// подключаем вашу структуру данных
+#include "buffered_r_tree.hpp"
+
+using namespace std;
+using namespace itis;
+
+// Одинаковые данные в двух местах: надгробие скрывает одну запись, и Flush ничего не меняет в ответах
+
+static bool count_result(int, void* a_context) {
+  ++*static_cast<int*>(a_context);
+  return true;
+}
+
+// Ответ Search и число вызовов callback должны совпадать с a_expected
+static bool check(BufferedRTree<int>& a_tree, const Rect& a_query, int a_expected, const char* a_name) {
+  int called = 0;
+  int found = a_tree.Search(a_query.m_min, a_query.m_max, count_result, &called);
+  if (found != a_expected || called != a_expected) {
+    cout << a_name << ": expected " << a_expected << ", found " << found << ", callbacks " << called << "\n";
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  const Rect first(0, 0, 10, 10);
+  const Rect second(1000, 1000, 1010, 1010);
+  const Rect whole(-100000, -100000, 100000, 100000);
+
+  bool ok = true;
+  for (auto policy : {SplitPolicy::kQuadratic, SplitPolicy::kHilbert}) {
+    BufferedRTree<int> tree(100, policy);
+    tree.Insert(first.m_min, first.m_max, 7);
+    tree.Insert(second.m_min, second.m_max, 7);
+    tree.Flush();
+
+    // Удаляем запись в first: в буфере остается надгробие
+    tree.Remove(first.m_min, first.m_max, 7);
+    for (int pass = 0; pass < 2; pass++) {
+      ok &= check(tree, whole, 1, pass == 0 ? "whole, buffered" : "whole, flushed");
+      ok &= check(tree, first, 0, pass == 0 ? "first, buffered" : "first, flushed");
+      ok &= check(tree, second, 1, pass == 0 ? "second, buffered" : "second, flushed");
+      tree.Flush();
+    }
+
+    // Два надгробия для двух записей скрывают обе
+    tree.Insert(first.m_min, first.m_max, 7);
+    tree.Flush();
+    tree.Remove(first.m_min, first.m_max, 7);
+    tree.Remove(second.m_min, second.m_max, 7);
+    ok &= check(tree, whole, 0, "both removed, buffered");
+    tree.Flush();
+    ok &= check(tree, whole, 0, "both removed, flushed");
+  }
+
+  cout << (ok ? "ok" : "failed") << "\n";
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "data_structure.hpp"
+
+// Буфер записи перед R-деревом для потоков частых вставок и удалений
+
+namespace itis {
+
+  // R-дерево с буфером изменений (как верхний уровень LSM-дерева).
+  // Insert и Remove попадают в небольшой несортированный буфер: вставки копятся в нем,
+  // а удаление записи, которая уже в дереве, оставляет надгробие (tombstone).
+  // Когда буфер заполняется, надгробия применяются к дереву, а вставки добавляются
+  // одной пачкой через BulkInsert. Search просматривает и буфер, и дерево.
+  // Записи различаются по DATATYPE: надгробие, пересекающее запрос, скрывает одну запись дерева
+  // с теми же данными (как Flush удалит одну), даже если таких записей несколько.
+  // Буфер проиндексирован по данным (нужен std::hash<DATATYPE>), поэтому Remove и проверка
+  // надгробий при поиске не просматривают его целиком
+  template <typename DATATYPE>
+  struct BufferedRTree
+  {
+   public:
+    using Rect = itis::Rect;
+    using SplitPolicy = itis::SplitPolicy;
+
+    // a_capacity - размер буфера (вставки и надгробия вместе), после которого он сливается с деревом.
+    // a_threadCount - потоки для упаковки пачки (0 - по числу ядер)
+    explicit BufferedRTree(int a_capacity = max_nodes, SplitPolicy a_policy = SplitPolicy::kQuadratic, int a_threadCount = 1);
+
+    // Вставка записи
+    void Insert(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
+
+    // Удаление записи
+    void Remove(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
+
+    // Найти все в прямоугольнике поиска (аналогично BasicRTree::Search)
+    int Search(const int a_min[dimensions], const int a_max[dimensions], bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context);
+
+    // Сливает буфер с деревом
+    void Flush();
+
+    // Подсчит элементов данных (сначала сливает буфер)
+    int Count();
+
+    // Дерево без учета буфера
+    BasicRTree<DATATYPE>& Tree()                   { return m_tree; }
+
+   protected:
+    // Контекст поиска по дереву: запрос, надгробия и callback пользователя
+    struct FilterContext
+    {
+      const Rect* m_rect;
+      const std::unordered_multimap<DATATYPE, Rect>* m_tombstones;
+      bool (*m_resultCallback)(DATATYPE, void*);
+      void* m_context;
+      int m_hiddenCount;
+      std::unordered_map<DATATYPE, int> m_remaining;  // Сколько записей с этими данными еще скрыть
+    };
+
+    // Передает пользователю результат из дерева, если запись не удалена надгробием
+    static bool FilterTombstones(DATATYPE a_data, void* a_context);
+
+    // Сливает буфер, если он заполнен
+    void FlushIfFull();
+
+    BasicRTree<DATATYPE> m_tree;
+    std::vector<Rect> m_insertRects;               // Ожидающие вставки: прямоугольники
+    std::vector<DATATYPE> m_insertData;            // и данные (отдельно, как их принимает BulkInsert)
+    std::unordered_multimap<DATATYPE, size_t> m_insertIndex;  // Позиции ожидающих вставок по данным
+    std::unordered_multimap<DATATYPE, Rect> m_tombstones;     // Записи, удаленные из дерева, но еще не из его узлов
+    int m_capacity;
+    int m_threadCount;
+  };
+
+  template <typename DATATYPE>
+  BufferedRTree<DATATYPE>::BufferedRTree(int a_capacity, SplitPolicy a_policy, int a_threadCount)
+      : m_tree(a_policy), m_capacity(std::max(1, a_capacity)), m_threadCount(a_threadCount) {
+    m_insertRects.reserve(static_cast<size_t> (m_capacity));
+    m_insertData.reserve(static_cast<size_t> (m_capacity));
+    m_insertIndex.reserve(static_cast<size_t> (m_capacity));
+  }
+
+  template <typename DATATYPE>
+  void BufferedRTree<DATATYPE>::Insert(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+    m_insertRects.push_back(rect);
+    m_insertData.push_back(a_data);
+    m_insertIndex.emplace(a_data, m_insertData.size() - 1);
+    FlushIfFull();
+  }
+
+  template <typename DATATYPE>
+  void BufferedRTree<DATATYPE>::Remove(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+
+    // Запись еще в буфере - просто забываем ее, поставив на ее место последнюю (порядок вставок не важен)
+    auto range = m_insertIndex.equal_range(a_data);
+    for(auto found = range.first; found != range.second; ++found)
+    {
+      size_t index = found->second;
+      if(!Overlap(rect, m_insertRects[index]))
+      {
+        continue;
+      }
+
+      m_insertIndex.erase(found);
+      size_t last = m_insertData.size() - 1;
+      if(index != last)
+      {
+        m_insertRects[index] = m_insertRects[last];
+        m_insertData[index] = m_insertData[last];
+        auto moved = m_insertIndex.equal_range(m_insertData[index]);
+        for(auto position = moved.first; position != moved.second; ++position)
+        {
+          if(position->second == last)
+          {
+            position->second = index;
+            break;
+          }
+        }
+      }
+      m_insertRects.pop_back();
+      m_insertData.pop_back();
+      return;
+    }
+
+    m_tombstones.emplace(a_data, rect);
+    FlushIfFull();
+  }
+
+  template <typename DATATYPE>
+  int BufferedRTree<DATATYPE>::Search(const int *a_min, const int *a_max, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+
+    int foundCount = 0;
+    for(size_t index = 0; index < m_insertRects.size(); ++index)
+    {
+      if(Overlap(rect, m_insertRects[index]))
+      {
+        ++foundCount;
+        if(a_resultCallback && !a_resultCallback(m_insertData[index], a_context))
+        {
+          return foundCount;
+        }
+      }
+    }
+
+    if(m_tombstones.empty())
+    {
+      return foundCount + m_tree.Search(a_min, a_max, a_resultCallback, a_context);
+    }
+
+    FilterContext filter;
+    filter.m_rect = &rect;
+    filter.m_tombstones = &m_tombstones;
+    filter.m_resultCallback = a_resultCallback;
+    filter.m_context = a_context;
+    filter.m_hiddenCount = 0;
+
+    int treeCount = m_tree.Search(a_min, a_max, FilterTombstones, &filter);
+    return foundCount + treeCount - filter.m_hiddenCount;
+  }
+
+  template <typename DATATYPE>
+  void BufferedRTree<DATATYPE>::Flush() {
+    // Сначала удаления: они относятся к записям, которые уже были в дереве
+    for(const auto& tombstone : m_tombstones)
+    {
+      m_tree.Remove(tombstone.second.m_min, tombstone.second.m_max, tombstone.first);
+    }
+    m_tombstones.clear();
+
+    m_tree.BulkInsert(m_insertRects.data(), m_insertData.data(), static_cast<int> (m_insertRects.size()), m_threadCount);
+    m_insertRects.clear();
+    m_insertData.clear();
+    m_insertIndex.clear();
+  }
+
+  template <typename DATATYPE>
+  int BufferedRTree<DATATYPE>::Count() {
+    Flush();
+    return m_tree.Count();
+  }
+
+  template <typename DATATYPE>
+  bool BufferedRTree<DATATYPE>::FilterTombstones(DATATYPE a_data, void *a_context) {
+    FilterContext* filter = static_cast<FilterContext*>(a_context);
+
+    // Запись в дереве может скрыть только надгробие с теми же данными, пересекающее запрос,
+    // и каждое надгробие - не больше одной записи. При первой встрече данных считаем такие надгробия
+    auto remaining = filter->m_remaining.find(a_data);
+    if(remaining == filter->m_remaining.end())
+    {
+      int count = 0;
+      auto range = filter->m_tombstones->equal_range(a_data);
+      for(auto tombstone = range.first; tombstone != range.second; ++tombstone)
+      {
+        if(Overlap(*filter->m_rect, tombstone->second))
+        {
+          ++count;
+        }
+      }
+      remaining = filter->m_remaining.emplace(a_data, count).first;
+    }
+
+    if(remaining->second > 0)
+    {
+      --remaining->second;
+      ++filter->m_hiddenCount;
+      return true;
+    }
+
+    if(filter->m_resultCallback)
+    {
+      return filter->m_resultCallback(a_data, filter->m_context);
+    }
+    return true;
+  }
+
+  template <typename DATATYPE>
+  void BufferedRTree<DATATYPE>::FlushIfFull() {
+    if(static_cast<int> (m_insertRects.size() + m_tombstones.size()) >= m_capacity)
+    {
+      Flush();
+    }
+  }
+
+}  // namespace itis
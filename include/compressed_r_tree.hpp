@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "data_structure.hpp"
+
+// Сжатое представление R-дерева для индексов, которые не помещаются в память
+
+namespace itis {
+
+  // Сжатый образ R-дерева (только для чтения)
+  // Прямоугольники дочерних ветвей хранятся смещениями OFFSET (uint8_t или uint16_t)
+  // относительно прямоугольника родителя и округляются наружу, поэтому Overlap не теряет записи.
+  // Идентификаторы в листе отсортированы и закодированы разностями (varint).
+  // Точная геометрия листьев хранится поправками к восстановленным прямоугольникам: их ширина в битах
+  // выбирается для каждого листа по наибольшей поправке, и проверяются они только для кандидатов.
+  template <typename OFFSET>
+  struct CompressedRTree
+  {
+   public:
+    // a_keepExact - хранить поправки до точных прямоугольников листьев для уточнения результатов.
+    // Без них Search возвращает кандидатов (надмножество ответа), уточнять которых должен вызывающий.
+    explicit CompressedRTree(const RTree& a_tree, bool a_keepExact = true);
+
+    // Найти все в прямоугольнике поиска (аналогично RTree::Search)
+    int Search(const int a_min[dimensions], const int a_max[dimensions], bool a_resultCallback(int a_data, void* a_context), void* a_context) const;
+
+    // Объем всего образа: узлы, координаты, идентификаторы и поправки к точной геометрии
+    size_t CompressedSize() const;
+
+    // Сколько из CompressedSize занимают поправки к точной геометрии листьев
+    size_t ExactSize() const;
+
+   protected:
+    struct Node
+    {
+      uint32_t m_first;                             // Первый дочерний узел или первая запись листа
+      uint32_t m_rectSlot;                          // Номер первого прямоугольника ветвей в m_coords
+      uint32_t m_idOffset;                          // Смещение идентификаторов листа в m_ids
+      uint32_t m_residualOffset;                    // Смещение поправок листа в m_residuals
+      uint16_t m_count;
+      uint16_t m_level;
+      uint8_t m_residualBits;                       // Бит на поправку; 0 - восстановленные прямоугольники точные
+    };
+
+    // Покрывающий прямоугольник непустого узла
+    template <typename NODE>
+    static RTree::Rect Cover(const NODE* a_node);
+
+    // Квантует прямоугольник относительно рамки родителя с округлением наружу
+    static void Quantize(const RTree::Rect& a_rect, const RTree::Rect& a_frame, OFFSET* a_coords);
+
+    // Восстанавливает прямоугольник, гарантированно содержащий исходный
+    static RTree::Rect Dequantize(const OFFSET* a_coords, const RTree::Rect& a_frame);
+
+    static void WriteVarint(uint64_t a_value, std::vector<uint8_t>& a_out);
+
+    static uint64_t ReadVarint(const uint8_t** a_in);
+
+    // Упаковка поправок: младшие a_bits бит значения начиная с бита a_bit
+    static void WriteBits(uint32_t a_value, int a_bits, uint64_t a_bit, uint8_t* a_out);
+
+    static uint32_t ReadBits(const uint8_t* a_in, uint64_t a_bit, int a_bits);
+
+    // Точный прямоугольник записи листа по восстановленному и поправкам
+    RTree::Rect Refine(const Node& a_node, uint32_t a_index, RTree::Rect a_rect) const;
+
+    bool Search(uint32_t a_node, const RTree::Rect& a_frame, const RTree::Rect& a_rect, int& a_foundCount, bool a_resultCallback(int a_data, void* a_context), void* a_context) const;
+
+    std::vector<Node> m_nodes;                      // Узлы в порядке обхода в ширину
+    std::vector<OFFSET> m_coords;                   // Квантованные прямоугольники ветвей
+    std::vector<uint8_t> m_ids;                     // Разностно закодированные идентификаторы
+    std::vector<uint8_t> m_residuals;               // Поправки к точной геометрии листьев
+    RTree::Rect m_rootRect;                         // Точная рамка корня
+    bool m_keepExact;
+  };
+
+  using CompressedRTree8 = CompressedRTree<uint8_t>;
+  using CompressedRTree16 = CompressedRTree<uint16_t>;
+
+}  // namespace itis
@@ -2,6 +2,10 @@
 #include <cstdio>
 #include <cmath>
 #include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <type_traits>
+#include <vector>
 
 using namespace std;
 // Заголовочный файл с объявлением структуры данных
@@ -11,27 +15,152 @@ namespace itis {
   inline constexpr int max_nodes = 10000;
   inline constexpr int min_nodes = 5000;
 
+  // Минимальный ограничивающий прямоугольник
+  struct Rect
+  { Rect()  {}
 
-  struct RTree
+    Rect(int a_minX, int a_minY, int a_maxX, int a_maxY)
+    {
+      m_min[0] = a_minX;
+      m_min[1] = a_minY;
+
+      m_max[0] = a_maxX;
+      m_max[1] = a_maxY;
+    }
+    int m_min[dimensions];                      // Минимальные размеры
+    int m_max[dimensions];                      // Максимальные размеры
+  };
+
+  // Пересекаются ли прямоугольники (границы включаются). Общая проверка для RTree и его оберток.
+  // Оси объединяются через &, без ветвлений: при сканировании листа условный переход остается один на запись
+  inline bool Overlap(const Rect& a_rectA, const Rect& a_rectB)
+  {
+    bool overlap = true;
+    for(int index=0; index < dimensions; ++index)
+    {
+      overlap &= (a_rectA.m_min[index] <= a_rectB.m_max[index]) & (a_rectB.m_min[index] <= a_rectA.m_max[index]);
+    }
+    return overlap;
+  }
+
+  // Точка - запись листа в дереве точек (BasicRTree<DATATYPE, Point>).
+  // Занимает вдвое меньше вырожденного Rect(x, y, x, y), поэтому лист с тем же числом записей короче
+  struct Point
+  { Point()  {}
+
+    Point(int a_x, int a_y)
+    {
+      m_coord[0] = a_x;
+      m_coord[1] = a_y;
+    }
+    int m_coord[dimensions];                    // Координаты
+  };
+
+  // Попадает ли точка в прямоугольник (границы включаются). Как и для двух Rect, оси
+  // проверяются все подряд через &, без раннего выхода
+  inline bool Overlap(const Rect& a_rect, const Point& a_point)
   {
+    bool overlap = true;
+    for(int index=0; index < dimensions; ++index)
+    {
+      overlap &= (a_rect.m_min[index] <= a_point.m_coord[index]) & (a_point.m_coord[index] <= a_rect.m_max[index]);
+    }
+    return overlap;
+  }
+
+  // Способ выбора поддерева для вставки и разделения переполненных узлов
+  enum class SplitPolicy
+  {
+    kQuadratic,  // квадратичный сплит Гуттмана (ChoosePartition)
+    kHilbert     // Hilbert R-tree: записи упорядочены по кривой Гильберта, отложенный сплит 2-к-3
+  };
+
+  // Тип площади для эвристик вставки и разделения (PickBranch, PickSeeds, ChoosePartition).
+  // Для целых координат площадь считается точно: произведение двух 32-битных сторон
+  // не помещается в int64, поэтому берется __int128, а без него - double
+  template <typename COORD>
+  struct AreaTraits
+  {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef __int128 Int128;
+    using Type = typename std::conditional<std::is_integral<COORD>::value, Int128, double>::type;
+#else
+    using Type = double;
+#endif
+  };
+
+  // Точная площадь для координат Rect
+  using ExactArea = AreaTraits<int>::Type;
+
+  // Значение кривой Гильберта (порядка 32) для центра прямоугольника
+  uint64_t HilbertValue(const Rect* a_rect);
+
+  // R-дерево с полезной нагрузкой DATATYPE в листьях.
+  // DATATYPE должен быть тривиально копируемым; для Remove нужен operator==
+  // GEOMETRY - что хранит запись листа: Rect или Point (тогда от прямоугольников
+  // в Insert/BulkLoad берется только m_min). Внутренние узлы всегда хранят Rect.
+  // AREA - тип площади в эвристиках; float оставлен для сравнения с прежним поведением
+  template <typename DATATYPE, typename GEOMETRY = Rect, typename AREA = ExactArea>
+  struct BasicRTree
+  {
+    static_assert(std::is_trivially_copyable<DATATYPE>::value, "Полезная нагрузка должна быть тривиально копируемой");
+    static_assert(std::is_same<GEOMETRY, itis::Rect>::value || std::is_same<GEOMETRY, itis::Point>::value, "Записи листа - Rect или Point");
+
    protected:
-    struct Node;  // предварительное объявление
+    struct NodeBase;  // предварительное объявление
+
+    template <typename OFFSET>
+    friend struct CompressedRTree;  // строит сжатый образ по узлам дерева
+
+    template <typename>
+    friend struct ShardedRTree;  // берет число потоков пула через ThreadCount
+
+    template <typename, typename>
+    friend struct FrozenRTree;  // копирует узлы в непрерывную память
+
+    template <typename>
+    friend struct DurableRTree;  // записывает измененные узлы и восстанавливает их из файла
 
    public:
-    RTree();
-    virtual ~RTree();
+    using Rect = itis::Rect;
+    using Point = itis::Point;
+    using SplitPolicy = itis::SplitPolicy;
+
+    explicit BasicRTree(SplitPolicy a_policy = SplitPolicy::kQuadratic);
+    virtual ~BasicRTree();
 
     // Вставка записи
-    void Insert(const int a_min[dimensions], const int a_max[dimensions], int a_dataId);
+    void Insert(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
 
-    // Удаление записи
-    void Remove(const int a_min[dimensions], const int a_max[dimensions], int a_dataId);
+    // Удаление записи: первой найденной с данными a_data, чей прямоугольник пересекает [a_min, a_max]
+    void Remove(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
 
 
     // Найти все в прямоугольнике поиска
     // a_resultCallback Функция для возврата результата. Вызов должен вернуть «true», чтобы продолжить поиск.
     // Возвращает количество найденных записей
-    int Search(const int a_min[dimensions], const int a_max[dimensions], bool __cdecl a_resultCallback(int a_data, void* a_context), void* a_context);
+    int Search(const int a_min[dimensions], const int a_max[dimensions], bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context);
+
+    // Найти все записи на расстоянии не больше a_radius от точки a_center
+    // (евклидово расстояние до прямоугольника записи, 0 - если точка внутри).
+    // Поддеревья отсекаются по MINDIST до их прямоугольников. Возвращает количество найденных записей
+    int SearchRadius(const int a_center[dimensions], double a_radius, bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context);
+
+    // Соединение по расстоянию: все пары (запись этого дерева, запись a_other), прямоугольники которых
+    // на расстоянии не больше a_distance. Деревья обходятся синхронно, пары ветвей двух узлов
+    // отбираются заметанием по оси x. Возвращает количество найденных пар
+    int DistanceJoin(BasicRTree& a_other, double a_distance, bool a_resultCallback(DATATYPE a_left, DATATYPE a_right, void* a_context), void* a_context);
+
+
+    // Построение дерева упаковкой вместо поочередных Insert: STR (слои по x, затем по y),
+    // а в режиме kHilbert - по кривой Гильберта. Старое содержимое удаляется.
+    // Вход делится по пространству между a_threadCount потоками (0 - по числу ядер)
+    void BulkLoad(const Rect* a_rects, const DATATYPE* a_data, int a_count, int a_threadCount = 0);
+
+    // Добавление пачки записей без удаления старых: записи распределяются по поддеревьям, как при Insert,
+    // и дописываются в листья. Переполненный узел упаковывается заново вместе с пришедшими записями
+    // так же, как в BulkLoad, поэтому новые узлы покрывают только свой участок, а не всю пачку
+    void BulkInsert(const Rect* a_rects, const DATATYPE* a_data, int a_count, int a_threadCount = 0);
 
 
     // Удаление всех записей из дерева
@@ -41,57 +170,87 @@ namespace itis {
     // Подсчит элементов данных
     int Count();
 
-   public:
+    // Неизменяемый снимок дерева. Разделяет узлы с деревом: пишущие операции копируют
+    // только те узлы на своем пути, на которые ссылается снимок (copy-on-write).
+    // Снимком можно пользоваться из другого потока, пока дерево меняется
+    class SnapshotView
+    {
+     public:
+      SnapshotView(const SnapshotView& a_other);
+      SnapshotView& operator=(const SnapshotView& a_other);
+      ~SnapshotView();
+
+      // Найти все в прямоугольнике поиска (аналогично BasicRTree::Search)
+      int Search(const int a_min[dimensions], const int a_max[dimensions], bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context) const;
 
-    // Минимальный ограничивающий прямоугольник
-    struct Rect
-    { Rect()  {}
+      // Подсчит элементов данных
+      int Count() const;
 
-      Rect(int a_minX, int a_minY, int a_maxX, int a_maxY)
-      {
-        m_min[0] = a_minX;
-        m_min[1] = a_minY;
+     private:
+      friend struct BasicRTree;
+      explicit SnapshotView(NodeBase* a_root);
 
-        m_max[0] = a_maxX;
-        m_max[1] = a_maxY;
-      }
-      int m_min[dimensions];                      // Минимальные размеры
-      int m_max[dimensions];                      // Максимальные размеры
+      NodeBase* m_root;
     };
 
+    // Снимок текущего состояния за O(1). Вызывать из пишущего потока
+    SnapshotView Snapshot();
+
    protected:
-    // Это могут быть данные или другое поддерево
-    // Это определяет уровень родителей.
-    // Если уровень родителей равен 0, то это данные
+    // Ветвь внутреннего узла - поддерево
     struct Branch
     {
       Rect m_rect;                                  // Границы
-      union
-      {
-        Node* m_child;                              // Дочерний узел
-        int m_data;                                 // Данные
-      };
+      NodeBase* m_child;                            // Дочерний узел
     };
 
-    // Узел для каждого уровня
-    struct Node
+    // Запись листа - данные
+    struct LeafBranch
+    {
+      GEOMETRY m_rect;                              // Границы (в дереве точек - сама точка)
+      DATATYPE m_data;                              // Данные
+    };
+
+    // Общая часть узлов. Уровень 0 - лист (LeafNode), иначе внутренний узел (Node)
+    struct NodeBase
     {
       bool IsInternalNode()                         { return (level > 0); }
       bool IsLeaf()                                 { return (level == 0); }
 
       int m_count;
       int level;
+      uint64_t m_lhv;                               // Наибольшее значение Гильберта в поддереве (для kHilbert)
+      std::atomic<int> m_refs;                      // Число ссылок на узел (родитель или корень, снимки)
+      uint64_t m_page;                              // Страница узла в файле DurableRTree (0 - узел не записан)
+    };
+
+    // Внутренний узел
+    struct Node : NodeBase
+    {
+      using BranchType = Branch;
       Branch m_branch[max_nodes];
     };
 
+    // Лист: хранит только данные, без указателей
+    struct LeafNode : NodeBase
+    {
+      using BranchType = LeafBranch;
+      LeafBranch m_branch[max_nodes];
+    };
+
+    // Тип узла, в котором хранятся ветви типа BRANCH
+    template <typename BRANCH>
+    using NodeOf = typename std::conditional<std::is_same<BRANCH, Branch>::value, Node, LeafNode>::type;
+
     // Список ссылок узлов для повторной вставки после операции удаления
     struct ListNode
     {
       ListNode* m_next;
-      Node* m_node;
+      NodeBase* m_node;
     };
 
     // Переменные для поиска разделителя
+    template <typename BRANCH>
     struct Vars {
       int m_partition[max_nodes + 1];
       int m_total;
@@ -99,45 +258,80 @@ namespace itis {
       int m_taken[max_nodes + 1];
       int m_count[2];
       Rect m_cover[2];
-      float m_area[2];
+      AREA m_area[2];
 
-      Branch m_branchBuf[max_nodes + 1];
+      BRANCH m_branchBuf[max_nodes + 1];
       int m_branchCount;
       Rect m_coverSplit;
-      float m_coverSplitArea;
+      AREA m_coverSplitArea;
+    };
+
+    // Буфер для перераспределения записей между соседними узлами в режиме kHilbert
+    template <typename BRANCH>
+    struct HilbertVars {
+      BRANCH m_branchBuf[2 * max_nodes + 1];
+      int m_branchCount;
+    };
+
+    // Элемент упаковки: ветвь и ее ключ на кривой Гильберта (для kHilbert)
+    template <typename BRANCH>
+    struct PackItem {
+      uint64_t m_key;
+      BRANCH m_branch;
     };
 
-    Node* LocateNode();
+    static Node* AsInternal(NodeBase* a_node)      { return static_cast<Node*>(a_node); }
+    static LeafNode* AsLeaf(NodeBase* a_node)      { return static_cast<LeafNode*>(a_node); }
+
+    // Создает лист или внутренний узел в зависимости от уровня
+    NodeBase* LocateNode(int a_level);
 
-    void InitNode(Node* a_node);
+    // Освобождает узел (без поддерева)
+    static void FreeNode(NodeBase* a_node);
+
+    // Копия узла с единственной ссылкой, дочерние узлы получают по ссылке
+    static NodeBase* CopyNode(NodeBase* a_node);
+
+    // Подготавливает узел, на который указывает a_slot, к изменению: если на него
+    // ссылается снимок, подменяет его копией. Сам a_slot должен принадлежать изменяемому узлу
+    static void MakeWritable(NodeBase** a_slot);
+
+    void InitNode(NodeBase* a_node);
 
     void InitRect(Rect* a_rect);
 
-    // Вставляет новый прямоугольник данных в структуру
+    // Вставляет новую ветвь (запись данных или поддерево) в структуру
     // Рекурсивно спускается по дереву
     // Возвращает 0, если узел не был разделен. Обновляет старый узел.
     // Если узел был разделен, возвращает 1 и устанавливает указатель, на который указывает
     // new_node, чтобы указать на новый узел. Обновляет старый узел.
     // Аргумент level указывает количество шагов вверх от листа
-    bool InsertRectRec(Rect* a_rect, const int& a_id, Node* a_node, Node** a_newNode, int a_level);
+    template <typename BRANCH>
+    bool InsertRectRec(BRANCH* a_branch, NodeBase* a_node, NodeBase** a_newNode, int a_level);
 
     // Вставляем прямоугольник данных в структуру
     // InsertRect обеспечивает разделение корня
     // возвращает 1, если корень был разделен, и 0, если нет.
     // Аргумент level указывает количество шагов вверх от листа
     // InsertRect выполняет рекурсию.
-    bool InsertRect(Rect* a_rect, const int& a_id, Node** a_root, int a_level);
+    template <typename BRANCH>
+    bool InsertRect(BRANCH* a_branch, NodeBase** a_root, int a_level);
 
     // Находим наименьший прямоугольник, включающий все прямоугольники в ветвях узла
-    Rect NodeCover(Node* a_node);
+    template <typename NODE>
+    Rect NodeCover(NODE* a_node);
+
+    Rect NodeCover(NodeBase* a_node);
 
     // Добавляем ветку к узлу. При необходимости разделяет узел.
     // Возвращает 0, если узел не разделен. Обновляет старый узел.
     // Возвращает 1, если узел разделен, устанавливает * new_node в адрес нового узла, обновляет старый узел
-    bool AddBranch(Branch* a_branch, Node* a_node, Node** a_newNode);
+    template <typename NODE>
+    bool AddBranch(typename NODE::BranchType* a_branch, NODE* a_node, NodeBase** a_newNode);
 
     // Отключает зависимый узел
-    void DisconnectBranch(Node* a_node, int a_index);
+    template <typename NODE>
+    void DisconnectBranch(NODE* a_node, int a_index);
 
     // Выбирает ветку, которая потребует наименьшего увеличения
     // в области для размещения нового прямоугольника.
@@ -151,16 +345,18 @@ namespace itis {
     // Разбиваем узел.
     // Разделяет ветви узлов и дополнительную ветвь между двумя узлами.
     // Старый узел - один из новых, поэтому создается самый новый.
-    void SplitNode(Node* a_node, Branch* a_branch, Node** a_newNode);
+    template <typename NODE>
+    void SplitNode(NODE* a_node, typename NODE::BranchType* a_branch, NodeBase** a_newNode);
 
     // Вычислить площадь прямоугольника
-    float RectVolume(Rect* a_rect);
+    AREA RectVolume(Rect* a_rect);
 
-    float CalcRectVolume(Rect* a_rect);
+    AREA CalcRectVolume(Rect* a_rect);
 
 
     // Создает ветвление с ветвями от полного узла
-    void GetBranches(Node* a_node, Branch* a_branch, Vars* a_parVars);
+    template <typename NODE>
+    void GetBranches(NODE* a_node, typename NODE::BranchType* a_branch, Vars<typename NODE::BranchType>* a_parVars);
 
     // В качестве начальных значений для двух групп выбираем два прямоугольника, которые покрывают площадь,
     // которую можно покрыть одним прямоугольником
@@ -168,45 +364,190 @@ namespace itis {
     // Выбираем те, у которых наибольшая разница площади
     // т.е. прямоугольник больше входит в одну группу чем в другую
     // При заполнении одной группы остальные прямоугольники включаются в другую
-    void ChoosePartition(Vars* a_parVars, int a_minFill);
+    template <typename BRANCH>
+    void ChoosePartition(Vars<BRANCH>* a_parVars, int a_minFill);
 
     // Копирует ветви из буфера в два узла в соответствии с разделителем
-    void LoadNodes(Node* a_nodeA, Node* a_nodeB, Vars* a_parVars);
+    template <typename NODE>
+    void LoadNodes(NODE* a_nodeA, NODE* a_nodeB, Vars<typename NODE::BranchType>* a_parVars);
 
-    void InitParVars(Vars* a_parVars, int a_maxRects, int a_minFill);
+    template <typename BRANCH>
+    void InitParVars(Vars<BRANCH>* a_parVars, int a_maxRects, int a_minFill);
 
-    void PickSeeds(Vars* a_parVars);
+    template <typename BRANCH>
+    void PickSeeds(Vars<BRANCH>* a_parVars);
 
     // Помещает ветку в одну из групп
-    void Classify(int a_index, int a_group, Vars* a_parVars);
+    template <typename BRANCH>
+    void Classify(int a_index, int a_group, Vars<BRANCH>* a_parVars);
 
     // Удаляем прямоугольник из структуры
-    // Передаем указатель на Rect, id записи, ptr на корневой узел.
+    // Передаем указатель на Rect, данные записи, ptr на корневой узел.
     // Возвращает 1, если запись не найдена, иначе 0.
     // RemoveRect позволяет удалить корень.
-    bool RemoveRect(Rect* a_rect, const int& a_id, Node** a_root);
+    bool RemoveRect(Rect* a_rect, const DATATYPE& a_data, NodeBase** a_root);
 
     // Удаляем прямоугольник из некорневой части индексной структуры.
     // Вызываем RemoveRect. Рекурсивно спускаемся по дереву,
     // объединяем ветви на обратном пути.
     // Возвращает 1, если запись не найдена, иначе 0.
-    bool RemoveRectRec(Rect* a_rect, const int& a_id, Node* a_node, ListNode** a_listNode);
+    bool RemoveRectRec(Rect* a_rect, const DATATYPE& a_data, NodeBase* a_node, ListNode** a_listNode);
+
+    // Есть ли запись в поддереве (без изменений, чтобы не копировать разделяемые узлы зря)
+    static bool ContainsEntry(Rect* a_rect, const DATATYPE& a_data, NodeBase* a_node);
 
     // Решает, перекрываются ли два прямоугольника
-    bool Overlap(Rect* a_rectA, Rect* a_rectB);
+    static bool Overlap(Rect* a_rectA, Rect* a_rectB);
+
+    // Попадает ли точка в прямоугольник
+    static bool Overlap(Rect* a_rect, Point* a_point);
+
+    // Прямоугольник записи листа: для точки - вырожденный
+    static Rect GeometryRect(const Rect& a_rect)   { return a_rect; }
+    static Rect GeometryRect(const Point& a_point);
+
+    // Записывает прямоугольник в запись листа: для точки берется m_min
+    static void SetGeometry(Rect* a_geometry, const Rect& a_rect)  { *a_geometry = a_rect; }
+    static void SetGeometry(Point* a_geometry, const Rect& a_rect);
+
+    // Удвоенная координата центра по оси a_axis (min + max без деления)
+    static int64_t GeometryCenter(const Rect& a_rect, int a_axis);
+    static int64_t GeometryCenter(const Point& a_point, int a_axis);
+
+    // Прямоугольник ветви любого уровня
+    static Rect BranchRect(const Branch* a_branch)      { return a_branch->m_rect; }
+    static Rect BranchRect(const LeafBranch* a_branch)  { return GeometryRect(a_branch->m_rect); }
 
     // Добавляем узел в список повторной вставки. Все его ветви будут
     // повторно вставленны
-    void ReInsert(Node* a_node, ListNode** a_listNode);
+    void ReInsert(NodeBase* a_node, ListNode** a_listNode);
 
     // Поиск в дереве или поддереве всех узловых точек, которые перекрывают прямоугольник
-    bool Search(Node* a_node, Rect* a_rect, int& a_foundCount, bool __cdecl a_resultCallback(int a_data, void* a_context), void* a_context);
+    static bool Search(NodeBase* a_node, Rect* a_rect, int& a_foundCount, bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context);
+
+    // Снимает ссылку на поддерево и удаляет узлы, на которые больше никто не ссылается
+    static void RemoveAllRec(NodeBase* a_node);
+
+    static void CountRec(NodeBase* a_node, int& a_count);
+
+    // Квадрат наименьшего расстояния от прямоугольника до точки и между прямоугольниками (MINDIST)
+    static double MinDistSquared(const Rect& a_rect, const int a_point[dimensions]);
+    static double MinDistSquared(const Rect& a_rectA, const Rect& a_rectB);
 
-    void RemoveAllRec(Node* a_node);
+    // Рекурсивный поиск по расстоянию. a_box - описанный вокруг круга квадрат: дешевая целочисленная
+    // проверка отбрасывает большинство ветвей до вычисления расстояния; a_radiusSquared - квадрат радиуса
+    static bool SearchRadius(NodeBase* a_node, Rect* a_box, const int a_center[dimensions], double a_radiusSquared, int& a_foundCount, bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context);
 
-    void CountRec(Node* a_node, int& a_count);
+    // Элемент соединения: прямоугольник и поддерево или данные записи
+    template <typename VALUE>
+    struct JoinItem {
+      Rect m_rect;
+      VALUE m_value;
+    };
 
-    Node* root;                                    // Корень
+    // Синхронный спуск по двум поддеревьям. Раскрывается узел более высокого уровня (при равных - оба),
+    // нераскрытый узел участвует целиком со своим прямоугольником
+    static bool DistanceJoinRec(NodeBase* a_left, const Rect& a_leftRect, NodeBase* a_right, const Rect& a_rightRect, double a_distance, int& a_foundCount, bool a_resultCallback(DATATYPE a_left, DATATYPE a_right, void* a_context), void* a_context);
+
+    // Ветви узла (или сам узел, если его не раскрываем) как элементы соединения
+    static void JoinChildren(NodeBase* a_node, const Rect& a_rect, bool a_expand, std::vector<JoinItem<NodeBase*>>& a_items);
+
+    // Заметание по оси x: вызывает a_pair для всех пар элементов на расстоянии не больше a_distance.
+    // Останавливается, если a_pair вернул false
+    template <typename LEFT, typename RIGHT, typename PAIR>
+    static bool SweepJoin(std::vector<JoinItem<LEFT>>& a_left, std::vector<JoinItem<RIGHT>>& a_right, double a_distance, PAIR a_pair);
+
+    // Ключ ветви для упорядочивания: для записи листа - значение Гильберта центра,
+    // для поддерева - наибольшее значение Гильберта (LHV) дочернего узла
+    uint64_t BranchLhv(LeafBranch* a_branch)       { Rect rect = BranchRect(a_branch); return HilbertValue(&rect); }
+    uint64_t BranchLhv(Branch* a_branch)           { return a_branch->m_child->m_lhv; }
+
+    // Наименьший ключ ветви: у записи листа совпадает с BranchLhv, у поддерева - ключ первой записи
+    // его первого листа. По нему ищется место новой ветви: при равных LHV (записи с одинаковым центром)
+    // поддерево встает после соседей, все ключи которых не больше его наименьшего
+    uint64_t BranchLowKey(LeafBranch* a_branch)    { return BranchLhv(a_branch); }
+    uint64_t BranchLowKey(const Branch* a_branch);
+
+    // Порядок ветвей при упаковке kHilbert: по ключу, при равных ключах поддеревья - по наименьшему ключу
+    static bool PackBefore(const PackItem<LeafBranch>& a_left, const PackItem<LeafBranch>& a_right) { return a_left.m_key < a_right.m_key; }
+    bool PackBefore(const PackItem<Branch>& a_left, const PackItem<Branch>& a_right);
+
+    // Вставка с упорядочиванием по кривой Гильберта
+    template <typename BRANCH>
+    bool InsertHilbertRect(BRANCH* a_branch, NodeBase** a_root, int a_level);
+
+    // Рекурсивный спуск для kHilbert по внутренним узлам выше уровня a_level. Узлы не разделяются сами:
+    // если узел полон, возвращает 1 и кладет не поместившуюся ветвь в a_overflow,
+    // переполнение разрешает родитель вместе с соседним узлом
+    template <typename BRANCH>
+    bool InsertHilbertRec(BRANCH* a_branch, uint64_t a_hilbert, Node* a_node, Branch* a_overflow, int a_level);
+
+    // Выбирает первую ветвь, у которой LHV не меньше a_hilbert (иначе последнюю)
+    int PickHilbertBranch(uint64_t a_hilbert, Node* a_node);
+
+    // Вставляет ветвь в узел с сохранением порядка. Возвращает 0, если узел был полон
+    template <typename NODE>
+    bool InsertSortedBranch(typename NODE::BranchType* a_branch, uint64_t a_hilbert, NODE* a_node);
+
+    // Разрешает переполнение дочернего узла a_index: перераспределяет записи с соседом,
+    // а если оба полны - делит записи двух узлов на три (отложенный сплит 2-к-3).
+    // Возвращает новый узел в a_newNode или nullptr, если новый узел не понадобился
+    template <typename NODE>
+    void HilbertOverflow(Node* a_parent, int a_index, typename NODE::BranchType* a_pending, NodeBase** a_newNode);
+
+    // Разрешает недозаполнение дочернего узла a_index: занимает записи у соседа или сливается с ним
+    template <typename NODE>
+    void HilbertUnderflow(Node* a_parent, int a_index);
+
+    // Собирает ветви a_nodeCount соседних узлов, начиная с a_first, в буфер
+    template <typename NODE>
+    void GatherSiblings(Node* a_parent, int a_first, int a_nodeCount, HilbertVars<typename NODE::BranchType>* a_vars);
+
+    // Равномерно раскладывает отсортированный буфер по a_nodeCount узлам
+    template <typename NODE>
+    void DistributeBranches(HilbertVars<typename NODE::BranchType>* a_vars, NODE** a_nodes, int a_nodeCount);
+
+    // Число потоков упаковки: 0 - по числу ядер
+    static int ThreadCount(int a_threadCount);
+
+    // Записи для упаковки с ключами кривой Гильберта (для kHilbert)
+    void LeafItems(const Rect* a_rects, const DATATYPE* a_data, int a_count, int a_threadCount, std::vector<PackItem<LeafBranch>>& a_items);
+
+    // Упаковывает записи в листья, ветви на листья кладет в a_leaves
+    void PackLeaves(const Rect* a_rects, const DATATYPE* a_data, int a_count, int a_threadCount, std::vector<PackItem<Branch>>& a_leaves);
+
+    // BulkInsert: раздает записи a_items детям узла *a_slot и сливает их в листьях.
+    // Ветви на узлы, появившиеся при переупаковке, кладет в a_extra
+    void MergeBatchRec(NodeBase** a_slot, std::vector<PackItem<LeafBranch>>& a_items, int a_threadCount, std::vector<PackItem<Branch>>& a_extra);
+
+    // Добавляет ветви a_items в узел *a_slot. Если они не помещаются, ветви узла и a_items упаковываются
+    // в несколько узлов того же уровня: первый встает на место *a_slot, остальные попадают в a_extra
+    template <typename BRANCH>
+    void MergeBranches(NodeBase** a_slot, std::vector<PackItem<BRANCH>>& a_items, int a_threadCount, std::vector<PackItem<Branch>>& a_extra);
+
+    // Упаковывает ветви одного уровня в узлы уровня a_level, ветви на новые узлы кладет в a_parents
+    template <typename BRANCH>
+    void PackLevel(std::vector<PackItem<BRANCH>>& a_items, int a_level, int a_threadCount, std::vector<PackItem<Branch>>& a_parents);
+
+    // Вызывает a_task(index) для каждого index из [0, a_count) на a_threadCount потоках
+    template <typename TASK>
+    static void ParallelFor(int a_count, int a_threadCount, TASK a_task);
+
+    // Раскладывает a_items так, чтобы каждая группа [a_cuts[i], a_cuts[i + 1]) при a_first <= i < a_last
+    // содержала нужные элементы (nth_element), половины обрабатываются параллельно
+    template <typename ITEM, typename LESS>
+    static void ParallelPartition(ITEM* a_items, const size_t* a_cuts, int a_first, int a_last, LESS a_less, int a_threadCount);
+
+    SplitPolicy m_policy;                          // Режим вставки и разделения
+    NodeBase* root;                                // Корень
   };
 
-}  // namespace itis
\ No newline at end of file
+  // Дерево с целочисленными идентификаторами записей
+  using RTree = BasicRTree<int>;
+
+  // Дерево точек с целочисленными идентификаторами записей
+  using PointRTree = BasicRTree<int, Point>;
+
+}  // namespace itis
+
+#include "data_structure_impl.hpp"
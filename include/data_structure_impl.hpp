@@ -0,0 +1,1752 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+// Определения шаблонных методов BasicRTree (подключается из data_structure.hpp)
+
+#define RTREE_TEMPLATE template <typename DATATYPE, typename GEOMETRY, typename AREA>
+#define RTREE_QUAL BasicRTree<DATATYPE, GEOMETRY, AREA>
+
+namespace itis {
+  RTREE_TEMPLATE
+  RTREE_QUAL::BasicRTree(SplitPolicy a_policy) : m_policy(a_policy) {
+    root = LocateNode(0);
+  }
+
+  RTREE_TEMPLATE
+  RTREE_QUAL::~BasicRTree() {
+    RemoveAllRec(root);
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::Insert(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    LeafBranch branch;
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+    SetGeometry(&branch.m_rect, rect);
+    branch.m_data = a_data;
+
+    MakeWritable(&root);
+    if(m_policy == SplitPolicy::kHilbert)
+    {
+      InsertHilbertRect(&branch, &root, 0);
+    }
+    else
+    {
+      InsertRect(&branch, &root, 0);
+    }
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::Remove(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+    RemoveRect(&rect, a_data, &root);
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::Search(const int *a_min, const int *a_max, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+
+    int foundCount = 0;
+    Search(root, &rect, foundCount, a_resultCallback, a_context);
+
+    return foundCount;
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::SearchRadius(const int *a_center, double a_radius, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) {
+    int foundCount = 0;
+    if(a_radius >= 0)
+    {
+      Rect box;
+      for(int axis=0; axis < dimensions; ++axis)
+      {
+        box.m_min[axis] = static_cast<int> (std::max<double> (INT32_MIN, std::floor(a_center[axis] - a_radius)));
+        box.m_max[axis] = static_cast<int> (std::min<double> (INT32_MAX, std::ceil(a_center[axis] + a_radius)));
+      }
+      SearchRadius(root, &box, a_center, a_radius * a_radius, foundCount, a_resultCallback, a_context);
+    }
+
+    return foundCount;
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::DistanceJoin(BasicRTree &a_other, double a_distance, bool (*a_resultCallback)(DATATYPE, DATATYPE, void *), void *a_context) {
+    int foundCount = 0;
+    if(a_distance >= 0 && root->m_count > 0 && a_other.root->m_count > 0)
+    {
+      DistanceJoinRec(root, NodeCover(root), a_other.root, a_other.NodeCover(a_other.root), a_distance, foundCount, a_resultCallback, a_context);
+    }
+
+    return foundCount;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::BulkLoad(const Rect *a_rects, const DATATYPE *a_data, int a_count, int a_threadCount) {
+    RemoveAllRec(root);
+
+    if(a_count <= 0)
+    {
+      root = LocateNode(0);
+      return;
+    }
+
+    int threadCount = ThreadCount(a_threadCount);
+
+    // Листья строятся параллельно, верхние уровни - тем же способом, пока не останется один узел
+    std::vector<PackItem<Branch>> parents;
+    PackLeaves(a_rects, a_data, a_count, threadCount, parents);
+    for(int level = 1; parents.size() > 1; ++level)
+    {
+      std::vector<PackItem<Branch>> upper;
+      PackLevel(parents, level, threadCount, upper);
+      parents.swap(upper);
+    }
+    root = parents[0].m_branch.m_child;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::BulkInsert(const Rect *a_rects, const DATATYPE *a_data, int a_count, int a_threadCount) {
+    if(a_count <= 0)
+    {
+      return;
+    }
+
+    int threadCount = ThreadCount(a_threadCount);
+    std::vector<PackItem<LeafBranch>> items;
+    LeafItems(a_rects, a_data, a_count, threadCount, items);
+
+    MakeWritable(&root);
+    std::vector<PackItem<Branch>> parents;
+    MergeBatchRec(&root, items, threadCount, parents);
+    if(parents.empty())
+    {
+      return;
+    }
+
+    // Корень переупакован в несколько узлов: над ними строятся верхние уровни, как в BulkLoad
+    PackItem<Branch> top;
+    top.m_key = root->m_lhv;
+    top.m_branch.m_rect = NodeCover(root);
+    top.m_branch.m_child = root;
+    parents.insert(parents.begin(), top);
+    for(int level = root->level + 1; parents.size() > 1; ++level)
+    {
+      std::vector<PackItem<Branch>> upper;
+      PackLevel(parents, level, threadCount, upper);
+      parents.swap(upper);
+    }
+    root = parents[0].m_branch.m_child;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::RemoveAll() {
+    RemoveAllRec(root);
+    root = LocateNode(0);
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::Count() {
+    int count = 0;
+    CountRec(root, count);
+    return count;
+  }
+
+  RTREE_TEMPLATE
+  typename RTREE_QUAL::SnapshotView RTREE_QUAL::Snapshot() {
+    return SnapshotView(root);
+  }
+
+  RTREE_TEMPLATE
+  RTREE_QUAL::SnapshotView::SnapshotView(NodeBase *a_root) : m_root(a_root) {
+    m_root->m_refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  RTREE_TEMPLATE
+  RTREE_QUAL::SnapshotView::SnapshotView(const SnapshotView &a_other) : m_root(a_other.m_root) {
+    m_root->m_refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  RTREE_TEMPLATE
+  typename RTREE_QUAL::SnapshotView &RTREE_QUAL::SnapshotView::operator=(const SnapshotView &a_other) {
+    a_other.m_root->m_refs.fetch_add(1, std::memory_order_relaxed);
+    RemoveAllRec(m_root);
+    m_root = a_other.m_root;
+    return *this;
+  }
+
+  RTREE_TEMPLATE
+  RTREE_QUAL::SnapshotView::~SnapshotView() {
+    RemoveAllRec(m_root);
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::SnapshotView::Search(const int *a_min, const int *a_max, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) const {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+
+    int foundCount = 0;
+    BasicRTree::Search(m_root, &rect, foundCount, a_resultCallback, a_context);
+
+    return foundCount;
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::SnapshotView::Count() const {
+    int count = 0;
+    CountRec(m_root, count);
+    return count;
+  }
+
+  RTREE_TEMPLATE
+  typename RTREE_QUAL::NodeBase *RTREE_QUAL::LocateNode(int a_level) {
+    NodeBase* newNode;
+    if(a_level == 0)
+    {
+      newNode = new LeafNode;
+    }
+    else
+    {
+      newNode = new Node;
+    }
+    InitNode(newNode);
+    newNode->level = a_level;
+    return newNode;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::FreeNode(NodeBase *a_node) {
+    if(a_node->IsLeaf())
+    {
+      delete AsLeaf(a_node);
+    }
+    else
+    {
+      delete AsInternal(a_node);
+    }
+  }
+
+  RTREE_TEMPLATE
+  typename RTREE_QUAL::NodeBase *RTREE_QUAL::CopyNode(NodeBase *a_node) {
+    NodeBase* copy;
+
+    if(a_node->IsLeaf())
+    {
+      LeafNode* leaf = new LeafNode;
+      std::copy(AsLeaf(a_node)->m_branch, AsLeaf(a_node)->m_branch + a_node->m_count, leaf->m_branch);
+      copy = leaf;
+    }
+    else
+    {
+      Node* node = new Node;
+      std::copy(AsInternal(a_node)->m_branch, AsInternal(a_node)->m_branch + a_node->m_count, node->m_branch);
+      // Теперь на детей ссылаются и оригинал, и копия
+      for(int index = 0; index < a_node->m_count; ++index)
+      {
+        node->m_branch[index].m_child->m_refs.fetch_add(1, std::memory_order_relaxed);
+      }
+      copy = node;
+    }
+
+    copy->m_count = a_node->m_count;
+    copy->level = a_node->level;
+    copy->m_lhv = a_node->m_lhv;
+    copy->m_refs.store(1, std::memory_order_relaxed);
+    copy->m_page = 0;  // копия изменится, записанная страница относится к оригиналу
+    return copy;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::MakeWritable(NodeBase **a_slot) {
+    NodeBase* node = *a_slot;
+    if(node->m_refs.load(std::memory_order_acquire) > 1)
+    {
+      // Узел виден снимку: подменяем копией, старую версию освободит последний снимок
+      *a_slot = CopyNode(node);
+      RemoveAllRec(node);
+    }
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::InitNode(NodeBase *a_node) {
+    a_node->m_count = 0;
+    a_node->level = -1;
+    a_node->m_lhv = 0;
+    a_node->m_refs.store(1, std::memory_order_relaxed);
+    a_node->m_page = 0;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::InitRect(Rect *a_rect) {
+    for(int index = 0; index < dimensions; ++index)
+    {
+      a_rect->m_min[index] = 0;
+      a_rect->m_max[index] = 0;
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  bool RTREE_QUAL::InsertRectRec(BRANCH *a_branch, NodeBase *a_node, NodeBase **a_newNode, int a_level) {
+    int index;
+    Branch branch;
+    NodeBase* otherNode;
+
+    // Все еще выше уровня для вставки, рекурсивно спускаемся по дереву
+    if(a_node->level > a_level)
+    {
+      Node* node = AsInternal(a_node);
+      Rect rect = BranchRect(a_branch);
+      index = PickBranch(&rect, node);
+      MakeWritable(&node->m_branch[index].m_child);
+      if (!InsertRectRec(a_branch, node->m_branch[index].m_child, &otherNode, a_level))
+      {
+        // Child не был разделен
+        node->m_branch[index].m_rect = CombineRect(&rect, &(node->m_branch[index].m_rect));
+        return false;
+      }
+      else // Child был разделен
+      {
+        node->m_branch[index].m_rect = NodeCover(node->m_branch[index].m_child);
+        branch.m_child = otherNode;
+        branch.m_rect = NodeCover(otherNode);
+        return AddBranch(&branch, node, a_newNode);
+      }
+    }
+    else if(a_node->level == a_level) // Дошли до уровня для вставки. Добавили прямоугольник, при необходимости разделили
+    {
+      return AddBranch(a_branch, static_cast<NodeOf<BRANCH>*>(a_node), a_newNode);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  bool RTREE_QUAL::InsertRect(BRANCH *a_branch, NodeBase **a_root, int a_level) {
+    Node* newRoot;
+    NodeBase* newNode;
+    Branch branch;
+
+    if(InsertRectRec(a_branch, *a_root, &newNode, a_level))  // Разделение корня
+    {
+      newRoot = AsInternal(LocateNode((*a_root)->level + 1));  // Делаем дерево выше и создаем новый корень
+      branch.m_rect = NodeCover(*a_root);
+      branch.m_child = *a_root;
+      AddBranch(&branch, newRoot, nullptr);
+      branch.m_rect = NodeCover(newNode);
+      branch.m_child = newNode;
+      AddBranch(&branch, newRoot, nullptr);
+      *a_root = newRoot;
+      return true;
+    }
+
+    return false;
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  typename RTREE_QUAL::Rect RTREE_QUAL::NodeCover(NODE *a_node) {
+    int firstTime = true;
+    Rect rect;
+    InitRect(&rect);
+
+    for(int index = 0; index < a_node->m_count; ++index)
+    {
+      Rect branchRect = BranchRect(&a_node->m_branch[index]);
+      if(firstTime)
+      {
+        rect = branchRect;
+        firstTime = false;
+      }
+      else
+      {
+        rect = CombineRect(&rect, &branchRect);
+      }
+    }
+
+    return rect;
+  }
+
+  RTREE_TEMPLATE
+  typename RTREE_QUAL::Rect RTREE_QUAL::NodeCover(NodeBase *a_node) {
+    if(a_node->IsLeaf())
+    {
+      return NodeCover(AsLeaf(a_node));
+    }
+    return NodeCover(AsInternal(a_node));
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  bool RTREE_QUAL::AddBranch(typename NODE::BranchType *a_branch, NODE *a_node, NodeBase **a_newNode) {
+    if(a_node->m_count < max_nodes)  // Сплит не понадобится
+    {
+      a_node->m_branch[a_node->m_count] = *a_branch;
+      ++a_node->m_count;
+
+      return false;
+    }
+    else
+    {
+      SplitNode(a_node, a_branch, a_newNode);
+      return true;
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::DisconnectBranch(NODE *a_node, int a_index) {
+    if(m_policy == SplitPolicy::kHilbert)
+    {
+      // Сдвигаем хвост, чтобы сохранить порядок по кривой Гильберта
+      for(int index = a_index; index < a_node->m_count - 1; ++index)
+      {
+        a_node->m_branch[index] = a_node->m_branch[index + 1];
+      }
+    }
+    else
+    {
+      // Удаляем элемент, заменив его последним элементом, чтобы предотвратить пробелы в массиве
+      a_node->m_branch[a_index] = a_node->m_branch[a_node->m_count - 1];
+    }
+    --a_node->m_count;
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::PickBranch(Rect *a_rect, Node *a_node) {
+    bool firstTime = true;
+    AREA increase;
+    AREA bestIncr =  static_cast<AREA> (-1);
+    AREA area;
+    AREA bestArea;
+    int best = 0;
+    Rect tempRect;
+
+    for(int index=0; index < a_node->m_count; ++index)
+    {
+      Rect* curRect = &a_node->m_branch[index].m_rect;
+      area = CalcRectVolume(curRect);
+      tempRect = CombineRect(a_rect, curRect);
+      increase = CalcRectVolume(&tempRect) - area;
+      if((increase < bestIncr) || firstTime)
+      {
+        best = index;
+        bestArea = area;
+        bestIncr = increase;
+        firstTime = false;
+      }
+      else if((increase == bestIncr) && (area < bestArea))
+      {
+        best = index;
+        bestArea = area;
+        bestIncr = increase;
+      }
+    }
+    return best;
+  }
+
+  RTREE_TEMPLATE
+  typename RTREE_QUAL::Rect RTREE_QUAL::CombineRect(Rect *a_rectA, Rect *a_rectB) {
+    Rect newRect;
+
+    for(int index = 0; index < dimensions; ++index)
+    {
+      newRect.m_min[index] = std::min(a_rectA->m_min[index], a_rectB->m_min[index]);
+      newRect.m_max[index] = std::max(a_rectA->m_max[index], a_rectB->m_max[index]);
+    }
+
+    return newRect;
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::SplitNode(NODE *a_node, typename NODE::BranchType *a_branch, NodeBase **a_newNode) {
+    Vars<typename NODE::BranchType> localVars;
+    Vars<typename NODE::BranchType> * parVars = &localVars;
+    int level;
+
+    // Загружаем все ветки в буфер, инициализируем старый узел
+    level = a_node->level;
+    GetBranches(a_node, a_branch, parVars);
+
+    // Находим разделение
+    ChoosePartition(parVars, min_nodes);
+
+    // Помещаем ветки из буфера в 2 узла в соответствии с выбранным разделом
+    *a_newNode = LocateNode(level);
+    a_node->level = level;
+    LoadNodes(a_node, static_cast<NODE*>(*a_newNode), parVars);
+  }
+
+  RTREE_TEMPLATE
+  AREA RTREE_QUAL::RectVolume(Rect *a_rect) {
+    AREA volume = static_cast<AREA> (1);
+
+    for(int index=0; index < dimensions; ++index)
+    {
+      volume *= static_cast<AREA> (static_cast<int64_t> (a_rect->m_max[index]) - a_rect->m_min[index]);
+    }
+    return volume;
+  }
+
+  RTREE_TEMPLATE
+  AREA RTREE_QUAL::CalcRectVolume(Rect *a_rect) {
+    return RectVolume(a_rect);
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::GetBranches(NODE *a_node, typename NODE::BranchType *a_branch, Vars<typename NODE::BranchType> *a_parVars) {
+    // Загружаем буфер branch
+    for(int index=0; index < max_nodes; ++index)
+    {
+      a_parVars->m_branchBuf[index] = a_node->m_branch[index];
+    }
+    a_parVars->m_branchBuf[max_nodes] = *a_branch;
+    a_parVars->m_branchCount = max_nodes + 1;
+
+    // Вычисляем прямоугольник, содержащий все в наборе
+    a_parVars->m_coverSplit = BranchRect(&a_parVars->m_branchBuf[0]);
+    for(int index=1; index < max_nodes + 1; ++index)
+    {
+      Rect branchRect = BranchRect(&a_parVars->m_branchBuf[index]);
+      a_parVars->m_coverSplit = CombineRect(&a_parVars->m_coverSplit, &branchRect);
+    }
+    a_parVars->m_coverSplitArea = CalcRectVolume(&a_parVars->m_coverSplit);
+
+    InitNode(a_node);
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  void RTREE_QUAL::ChoosePartition(Vars<BRANCH> *a_parVars, int a_minFill) {
+    AREA biggestDiff;
+    int group, chosen = 0, betterGroup = 0;
+
+    InitParVars(a_parVars, a_parVars->m_branchCount, a_minFill);
+    PickSeeds(a_parVars);
+
+    while (((a_parVars->m_count[0] + a_parVars->m_count[1]) < a_parVars->m_total)
+           && (a_parVars->m_count[0] < (a_parVars->m_total - a_parVars->m_minFill))
+           && (a_parVars->m_count[1] < (a_parVars->m_total - a_parVars->m_minFill)))
+    {
+      biggestDiff = static_cast<AREA> (-1);
+      for(int index=0; index<a_parVars->m_total; ++index)
+      {
+        if(!a_parVars->m_taken[index])
+        {
+          Rect curRect = BranchRect(&a_parVars->m_branchBuf[index]);
+          Rect rect0 = CombineRect(&curRect, &a_parVars->m_cover[0]);
+          Rect rect1 = CombineRect(&curRect, &a_parVars->m_cover[1]);
+          AREA growth0 = CalcRectVolume(&rect0) - a_parVars->m_area[0];
+          AREA growth1 = CalcRectVolume(&rect1) - a_parVars->m_area[1];
+          AREA diff = growth1 - growth0;
+          if(diff >= 0)
+          {
+            group = 0;
+          }
+          else
+          {
+            group = 1;
+            diff = -diff;
+          }
+
+          if(diff > biggestDiff)
+          {
+            biggestDiff = diff;
+            chosen = index;
+            betterGroup = group;
+          }
+          else if((diff == biggestDiff) && (a_parVars->m_count[group] < a_parVars->m_count[betterGroup]))
+          {
+            chosen = index;
+            betterGroup = group;
+          }
+        }
+      }
+      Classify(chosen, betterGroup, a_parVars);
+    }
+
+    // Если одна группа заполнена, помещаем оставшиеся прямоугольники в другую.
+    if((a_parVars->m_count[0] + a_parVars->m_count[1]) < a_parVars->m_total)
+    {
+      if(a_parVars->m_count[0] >= a_parVars->m_total - a_parVars->m_minFill)
+      {
+        group = 1;
+      }
+      else
+      {
+        group = 0;
+      }
+      for(int index=0; index<a_parVars->m_total; ++index)
+      {
+        if(!a_parVars->m_taken[index])
+        {
+          Classify(index, group, a_parVars);
+        }
+      }
+    }
+
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::LoadNodes(NODE *a_nodeA, NODE *a_nodeB, Vars<typename NODE::BranchType> *a_parVars) {
+    for(int index=0; index < a_parVars->m_total; ++index)
+    {
+      if(a_parVars->m_partition[index] == 0)
+      {
+        AddBranch(&a_parVars->m_branchBuf[index], a_nodeA, nullptr);
+      }
+      else if(a_parVars->m_partition[index] == 1)
+      {
+        AddBranch(&a_parVars->m_branchBuf[index], a_nodeB, nullptr);
+      }
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  void RTREE_QUAL::InitParVars(Vars<BRANCH> *a_parVars, int a_maxRects, int a_minFill) {
+    a_parVars->m_count[0] = a_parVars->m_count[1] = 0;
+    a_parVars->m_area[0] = a_parVars->m_area[1] = static_cast<AREA> (0);
+    a_parVars->m_total = a_maxRects;
+    a_parVars->m_minFill = a_minFill;
+    for(int index=0; index < a_maxRects; ++index)
+    {
+      a_parVars->m_taken[index] = false;
+      a_parVars->m_partition[index] = -1;
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  void RTREE_QUAL::PickSeeds(Vars<BRANCH> *a_parVars) {
+
+    int seed0 = 0, seed1 = 1;
+    AREA worst, waste;
+    std::vector<AREA> area(static_cast<size_t> (a_parVars->m_total));
+
+    for(int index=0; index<a_parVars->m_total; ++index)
+    {
+      Rect branchRect = BranchRect(&a_parVars->m_branchBuf[index]);
+      area[static_cast<size_t> (index)] = CalcRectVolume(&branchRect);
+    }
+
+    worst = -a_parVars->m_coverSplitArea - 1;
+    for(int indexA=0; indexA < a_parVars->m_total-1; ++indexA)
+    {
+      for(int indexB = indexA+1; indexB < a_parVars->m_total; ++indexB)
+      {
+        Rect rectA = BranchRect(&a_parVars->m_branchBuf[indexA]);
+        Rect rectB = BranchRect(&a_parVars->m_branchBuf[indexB]);
+        Rect oneRect = CombineRect(&rectA, &rectB);
+        waste = CalcRectVolume(&oneRect) - area[static_cast<size_t> (indexA)] - area[static_cast<size_t> (indexB)];
+        if(waste > worst)
+        {
+          worst = waste;
+          seed0 = indexA;
+          seed1 = indexB;
+        }
+      }
+    }
+    Classify(seed0, 0, a_parVars);
+    Classify(seed1, 1, a_parVars);
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  void RTREE_QUAL::Classify(int a_index, int a_group, Vars<BRANCH> *a_parVars) {
+    a_parVars->m_partition[a_index] = a_group;
+    a_parVars->m_taken[a_index] = true;
+
+    Rect branchRect = BranchRect(&a_parVars->m_branchBuf[a_index]);
+    if (a_parVars->m_count[a_group] == 0)
+    {
+      a_parVars->m_cover[a_group] = branchRect;
+    }
+    else
+    {
+      a_parVars->m_cover[a_group] = CombineRect(&branchRect, &a_parVars->m_cover[a_group]);
+    }
+    a_parVars->m_area[a_group] = CalcRectVolume(&a_parVars->m_cover[a_group]);
+    ++a_parVars->m_count[a_group];
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::RemoveRect(Rect *a_rect, const DATATYPE &a_data, NodeBase **a_root) {
+    NodeBase* tempNode;
+    ListNode* reInsertList = nullptr;
+
+    // Не копируем разделяемый со снимком корень, если записи нет
+    if((*a_root)->m_refs.load(std::memory_order_acquire) > 1 && !ContainsEntry(a_rect, a_data, *a_root))
+    {
+      return true;
+    }
+    MakeWritable(a_root);
+
+    if(!RemoveRectRec(a_rect, a_data, *a_root, &reInsertList))
+    {
+      // Находим и удаляем элемент данных
+      // Повторно вставляем все ветви из удаленных узлов
+      while(reInsertList)
+      {
+        tempNode = reInsertList->m_node;
+
+        for(int index = 0; index < tempNode->m_count; ++index)
+        {
+          if(tempNode->IsLeaf())
+          {
+            InsertRect(&(AsLeaf(tempNode)->m_branch[index]), a_root, tempNode->level);
+          }
+          else
+          {
+            InsertRect(&(AsInternal(tempNode)->m_branch[index]), a_root, tempNode->level);
+          }
+        }
+
+        ListNode* remLNode = reInsertList;
+        reInsertList = reInsertList->m_next;
+        FreeNode(remLNode->m_node);
+        delete remLNode;
+      }
+
+      // Проверяем наличие избыточного корня (не лист, 1 ребенок) и удаляем
+      if((*a_root)->m_count == 1 && (*a_root)->IsInternalNode())
+      {
+        tempNode = AsInternal(*a_root)->m_branch[0].m_child;
+        FreeNode(*a_root);
+        *a_root = tempNode;
+      }
+      return false;
+    }
+    else
+    {
+      return true;
+    }
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::RemoveRectRec(Rect *a_rect, const DATATYPE &a_data, NodeBase *a_node, ListNode **a_listNode) {
+    if(a_node->IsInternalNode())  // не лист
+    {
+      Node* node = AsInternal(a_node);
+      for(int index = 0; index < node->m_count; ++index)
+      {
+        if(Overlap(a_rect, &(node->m_branch[index].m_rect)))
+        {
+          NodeBase** slot = &node->m_branch[index].m_child;
+          if((*slot)->m_refs.load(std::memory_order_acquire) > 1 && !ContainsEntry(a_rect, a_data, *slot))
+          {
+            continue;
+          }
+          MakeWritable(slot);
+
+          if(!RemoveRectRec(a_rect, a_data, *slot, a_listNode))
+          {
+            NodeBase* child = node->m_branch[index].m_child;
+            if(m_policy == SplitPolicy::kHilbert)
+            {
+              // Вместо повторной вставки занимаем записи у соседа или сливаемся с ним,
+              // чтобы не нарушить порядок по кривой Гильберта
+              if(child->m_count >= min_nodes)
+              {
+                node->m_branch[index].m_rect = NodeCover(child);
+              }
+              else if(child->IsLeaf())
+              {
+                HilbertUnderflow<LeafNode>(node, index);
+              }
+              else
+              {
+                HilbertUnderflow<Node>(node, index);
+              }
+              node->m_lhv = BranchLhv(&node->m_branch[node->m_count - 1]);
+            }
+            else if(child->m_count >= min_nodes)
+            {
+              // дочерний элемент удален, просто изменяем размер родительского прямоугольника
+              node->m_branch[index].m_rect = NodeCover(child);
+            }
+            else
+            {
+              // дочерний элемент удален, в узле недостаточно записей, удаляем узел
+              ReInsert(child, a_listNode);
+              DisconnectBranch(node, index);
+            }
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+    else // лист
+    {
+      LeafNode* leaf = AsLeaf(a_node);
+      for(int index = 0; index < leaf->m_count; ++index)
+      {
+        // Одинаковые данные могут лежать в нескольких местах - удаляем ту запись, что пересекает a_rect
+        if(leaf->m_branch[index].m_data == a_data && Overlap(a_rect, &leaf->m_branch[index].m_rect))
+        {
+          DisconnectBranch(leaf, index);
+          if(m_policy == SplitPolicy::kHilbert)
+          {
+            leaf->m_lhv = (leaf->m_count > 0) ? BranchLhv(&leaf->m_branch[leaf->m_count - 1]) : 0;
+          }
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::ContainsEntry(Rect *a_rect, const DATATYPE &a_data, NodeBase *a_node) {
+    if(a_node->IsInternalNode())
+    {
+      Node* node = AsInternal(a_node);
+      for(int index = 0; index < node->m_count; ++index)
+      {
+        if(Overlap(a_rect, &(node->m_branch[index].m_rect)) && ContainsEntry(a_rect, a_data, node->m_branch[index].m_child))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    LeafNode* leaf = AsLeaf(a_node);
+    for(int index = 0; index < leaf->m_count; ++index)
+    {
+      if(leaf->m_branch[index].m_data == a_data && Overlap(a_rect, &leaf->m_branch[index].m_rect))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::Overlap(Rect *a_rectA, Rect *a_rectB) {
+    return itis::Overlap(*a_rectA, *a_rectB);
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::Overlap(Rect *a_rect, Point *a_point) {
+    return itis::Overlap(*a_rect, *a_point);
+  }
+
+  RTREE_TEMPLATE
+  typename RTREE_QUAL::Rect RTREE_QUAL::GeometryRect(const Point &a_point) {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_point.m_coord[axis];
+      rect.m_max[axis] = a_point.m_coord[axis];
+    }
+    return rect;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::SetGeometry(Point *a_geometry, const Rect &a_rect) {
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      a_geometry->m_coord[axis] = a_rect.m_min[axis];
+    }
+  }
+
+  RTREE_TEMPLATE
+  int64_t RTREE_QUAL::GeometryCenter(const Rect &a_rect, int a_axis) {
+    return static_cast<int64_t> (a_rect.m_min[a_axis]) + a_rect.m_max[a_axis];
+  }
+
+  RTREE_TEMPLATE
+  int64_t RTREE_QUAL::GeometryCenter(const Point &a_point, int a_axis) {
+    return 2 * static_cast<int64_t> (a_point.m_coord[a_axis]);
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::ReInsert(NodeBase *a_node, ListNode **a_listNode) {
+
+    ListNode* newListNode;
+
+    newListNode = new ListNode;
+    newListNode->m_node = a_node;
+    newListNode->m_next = *a_listNode;
+    *a_listNode = newListNode;
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::Search(NodeBase *a_node, Rect *a_rect, int &a_foundCount, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) {
+    if(a_node->IsInternalNode()) // Это внутренний узел в дереве
+    {
+      Node* node = AsInternal(a_node);
+      for(int index=0; index < node->m_count; ++index)
+      {
+        if(Overlap(a_rect, &node->m_branch[index].m_rect))
+        {
+          if(!Search(node->m_branch[index].m_child, a_rect, a_foundCount, a_resultCallback, a_context))
+          {
+            return false;
+          }
+        }
+      }
+    }
+    else // Лист
+    {
+      LeafNode* leaf = AsLeaf(a_node);
+      for(int index=0; index < leaf->m_count; ++index)
+      {
+        if(Overlap(a_rect, &leaf->m_branch[index].m_rect))
+        {
+          ++a_foundCount;
+          if(a_resultCallback && !a_resultCallback(leaf->m_branch[index].m_data, a_context))
+          {
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::RemoveAllRec(NodeBase *a_node) {
+    // Узел еще нужен снимку или дереву
+    if(a_node->m_refs.fetch_sub(1, std::memory_order_acq_rel) > 1)
+    {
+      return;
+    }
+
+    if(a_node->IsInternalNode()) // Это внутренний узел в дереве
+    {
+      Node* node = AsInternal(a_node);
+      for(int index=0; index < node->m_count; ++index)
+      {
+        RemoveAllRec(node->m_branch[index].m_child);
+      }
+    }
+    FreeNode(a_node);
+  }
+
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::CountRec(NodeBase *a_node, int &a_count) {
+
+    if(a_node->IsInternalNode())  // не листовой узел
+    {
+      Node* node = AsInternal(a_node);
+      for(int index = 0; index < node->m_count; ++index)
+      {
+        CountRec(node->m_branch[index].m_child, a_count);
+      }
+    }
+    else // листовой узел
+    {
+      a_count += a_node->m_count;
+    }
+  }
+
+  RTREE_TEMPLATE
+  double RTREE_QUAL::MinDistSquared(const Rect &a_rect, const int *a_point) {
+    double distance = 0;
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      double delta = 0;
+      if(a_point[axis] < a_rect.m_min[axis])
+      {
+        delta = static_cast<double> (a_rect.m_min[axis]) - a_point[axis];
+      }
+      else if(a_point[axis] > a_rect.m_max[axis])
+      {
+        delta = static_cast<double> (a_point[axis]) - a_rect.m_max[axis];
+      }
+      distance += delta * delta;
+    }
+    return distance;
+  }
+
+  RTREE_TEMPLATE
+  double RTREE_QUAL::MinDistSquared(const Rect &a_rectA, const Rect &a_rectB) {
+    double distance = 0;
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      double delta = 0;
+      if(a_rectA.m_max[axis] < a_rectB.m_min[axis])
+      {
+        delta = static_cast<double> (a_rectB.m_min[axis]) - a_rectA.m_max[axis];
+      }
+      else if(a_rectB.m_max[axis] < a_rectA.m_min[axis])
+      {
+        delta = static_cast<double> (a_rectA.m_min[axis]) - a_rectB.m_max[axis];
+      }
+      distance += delta * delta;
+    }
+    return distance;
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::SearchRadius(NodeBase *a_node, Rect *a_box, const int *a_center, double a_radiusSquared, int &a_foundCount, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) {
+    if(a_node->IsInternalNode()) // Это внутренний узел в дереве
+    {
+      Node* node = AsInternal(a_node);
+      for(int index=0; index < node->m_count; ++index)
+      {
+        if(Overlap(a_box, &node->m_branch[index].m_rect) && MinDistSquared(node->m_branch[index].m_rect, a_center) <= a_radiusSquared)
+        {
+          if(!SearchRadius(node->m_branch[index].m_child, a_box, a_center, a_radiusSquared, a_foundCount, a_resultCallback, a_context))
+          {
+            return false;
+          }
+        }
+      }
+    }
+    else // Лист
+    {
+      LeafNode* leaf = AsLeaf(a_node);
+      for(int index=0; index < leaf->m_count; ++index)
+      {
+        if(Overlap(a_box, &leaf->m_branch[index].m_rect) && MinDistSquared(BranchRect(&leaf->m_branch[index]), a_center) <= a_radiusSquared)
+        {
+          ++a_foundCount;
+          if(a_resultCallback && !a_resultCallback(leaf->m_branch[index].m_data, a_context))
+          {
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::DistanceJoinRec(NodeBase *a_left, const Rect &a_leftRect, NodeBase *a_right, const Rect &a_rightRect, double a_distance, int &a_foundCount,
+                                   bool (*a_resultCallback)(DATATYPE, DATATYPE, void *), void *a_context) {
+    if(a_left->IsLeaf() && a_right->IsLeaf())
+    {
+      std::vector<JoinItem<DATATYPE>> left;
+      std::vector<JoinItem<DATATYPE>> right;
+      double distanceSquared = a_distance * a_distance;
+
+      // Берем только записи, которые могут оказаться рядом с другим листом
+      for(int index = 0; index < a_left->m_count; ++index)
+      {
+        LeafBranch* branch = &AsLeaf(a_left)->m_branch[index];
+        Rect rect = BranchRect(branch);
+        if(MinDistSquared(rect, a_rightRect) <= distanceSquared)
+        {
+          left.push_back(JoinItem<DATATYPE>{rect, branch->m_data});
+        }
+      }
+      for(int index = 0; index < a_right->m_count; ++index)
+      {
+        LeafBranch* branch = &AsLeaf(a_right)->m_branch[index];
+        Rect rect = BranchRect(branch);
+        if(MinDistSquared(rect, a_leftRect) <= distanceSquared)
+        {
+          right.push_back(JoinItem<DATATYPE>{rect, branch->m_data});
+        }
+      }
+
+      return SweepJoin(left, right, a_distance, [&](const JoinItem<DATATYPE>& a_leftItem, const JoinItem<DATATYPE>& a_rightItem) {
+        ++a_foundCount;
+        return !a_resultCallback || a_resultCallback(a_leftItem.m_value, a_rightItem.m_value, a_context);
+      });
+    }
+
+    std::vector<JoinItem<NodeBase*>> left;
+    std::vector<JoinItem<NodeBase*>> right;
+    JoinChildren(a_left, a_leftRect, a_left->level >= a_right->level, left);
+    JoinChildren(a_right, a_rightRect, a_right->level >= a_left->level, right);
+
+    return SweepJoin(left, right, a_distance, [&](const JoinItem<NodeBase*>& a_leftItem, const JoinItem<NodeBase*>& a_rightItem) {
+      return DistanceJoinRec(a_leftItem.m_value, a_leftItem.m_rect, a_rightItem.m_value, a_rightItem.m_rect, a_distance, a_foundCount, a_resultCallback, a_context);
+    });
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::JoinChildren(NodeBase *a_node, const Rect &a_rect, bool a_expand, std::vector<JoinItem<NodeBase*>> &a_items) {
+    if(!a_expand || a_node->IsLeaf())
+    {
+      a_items.push_back(JoinItem<NodeBase*>{a_rect, a_node});
+      return;
+    }
+
+    Node* node = AsInternal(a_node);
+    for(int index = 0; index < node->m_count; ++index)
+    {
+      a_items.push_back(JoinItem<NodeBase*>{node->m_branch[index].m_rect, node->m_branch[index].m_child});
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename LEFT, typename RIGHT, typename PAIR>
+  bool RTREE_QUAL::SweepJoin(std::vector<JoinItem<LEFT>> &a_left, std::vector<JoinItem<RIGHT>> &a_right, double a_distance, PAIR a_pair) {
+    auto byMinX = [](const auto& a_first, const auto& a_second) { return a_first.m_rect.m_min[0] < a_second.m_rect.m_min[0]; };
+    std::sort(a_left.begin(), a_left.end(), byMinX);
+    std::sort(a_right.begin(), a_right.end(), byMinX);
+    double distanceSquared = a_distance * a_distance;
+
+    // Очередной элемент с наименьшим m_min[0] сравнивается с элементами другой стороны,
+    // которые начинаются не дальше a_distance от его правого края
+    size_t left = 0;
+    size_t right = 0;
+    while(left < a_left.size() && right < a_right.size())
+    {
+      if(a_left[left].m_rect.m_min[0] <= a_right[right].m_rect.m_min[0])
+      {
+        const JoinItem<LEFT>& item = a_left[left++];
+        for(size_t other = right; other < a_right.size()
+            && a_right[other].m_rect.m_min[0] <= static_cast<double> (item.m_rect.m_max[0]) + a_distance; ++other)
+        {
+          if(MinDistSquared(item.m_rect, a_right[other].m_rect) <= distanceSquared && !a_pair(item, a_right[other]))
+          {
+            return false;
+          }
+        }
+      }
+      else
+      {
+        const JoinItem<RIGHT>& item = a_right[right++];
+        for(size_t other = left; other < a_left.size()
+            && a_left[other].m_rect.m_min[0] <= static_cast<double> (item.m_rect.m_max[0]) + a_distance; ++other)
+        {
+          if(MinDistSquared(a_left[other].m_rect, item.m_rect) <= distanceSquared && !a_pair(a_left[other], item))
+          {
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  bool RTREE_QUAL::InsertHilbertRect(BRANCH *a_branch, NodeBase **a_root, int a_level) {
+    using TargetNode = NodeOf<BRANCH>;
+    NodeBase* oldRoot = *a_root;
+    uint64_t hilbert = BranchLhv(a_branch);
+    Branch overflow;
+    Node* newRoot;
+    NodeBase* newNode;
+    Branch branch;
+
+    if(oldRoot->level == a_level)
+    {
+      if(InsertSortedBranch(a_branch, hilbert, static_cast<TargetNode*>(oldRoot)))
+      {
+        return false;
+      }
+    }
+    else if(!InsertHilbertRec(a_branch, hilbert, AsInternal(oldRoot), &overflow, a_level))
+    {
+      return false;
+    }
+
+    // У корня нет соседей, поэтому делим его пополам под новым корнем
+    newRoot = AsInternal(LocateNode(oldRoot->level + 1));
+    branch.m_rect = NodeCover(oldRoot);
+    branch.m_child = oldRoot;
+    AddBranch(&branch, newRoot, nullptr);
+
+    if(oldRoot->level == a_level)
+    {
+      HilbertOverflow<TargetNode>(newRoot, 0, a_branch, &newNode);
+    }
+    else
+    {
+      HilbertOverflow<Node>(newRoot, 0, &overflow, &newNode);
+    }
+    branch.m_rect = NodeCover(newNode);
+    branch.m_child = newNode;
+    AddBranch(&branch, newRoot, nullptr);
+    newRoot->m_lhv = newNode->m_lhv;
+
+    *a_root = newRoot;
+    return true;
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  bool RTREE_QUAL::InsertHilbertRec(BRANCH *a_branch, uint64_t a_hilbert, Node *a_node, Branch *a_overflow, int a_level) {
+    using TargetNode = NodeOf<BRANCH>;
+    int index = PickHilbertBranch(a_hilbert, a_node);
+    MakeWritable(&a_node->m_branch[index].m_child);
+    NodeBase* child = a_node->m_branch[index].m_child;
+    NodeBase* newNode;
+    Rect rect = BranchRect(a_branch);
+
+    if(child->level == a_level)
+    {
+      // Дошли до уровня для вставки
+      if(InsertSortedBranch(a_branch, a_hilbert, static_cast<TargetNode*>(child)))
+      {
+        a_node->m_branch[index].m_rect = CombineRect(&rect, &(a_node->m_branch[index].m_rect));
+        a_node->m_lhv = std::max(a_node->m_lhv, a_hilbert);
+        return false;
+      }
+      // Child полон: перераспределяем записи с соседом, при необходимости появляется третий узел
+      HilbertOverflow<TargetNode>(a_node, index, a_branch, &newNode);
+    }
+    else
+    {
+      Branch pending;
+      if(!InsertHilbertRec(a_branch, a_hilbert, AsInternal(child), &pending, a_level))
+      {
+        // Child не был переполнен
+        a_node->m_branch[index].m_rect = CombineRect(&rect, &(a_node->m_branch[index].m_rect));
+        a_node->m_lhv = std::max(a_node->m_lhv, a_hilbert);
+        return false;
+      }
+      HilbertOverflow<Node>(a_node, index, &pending, &newNode);
+    }
+
+    a_node->m_lhv = std::max(a_node->m_lhv, a_hilbert);
+    if(newNode == nullptr)
+    {
+      return false;
+    }
+
+    Branch branch;
+    branch.m_rect = NodeCover(newNode);
+    branch.m_child = newNode;
+    if(InsertSortedBranch(&branch, newNode->m_lhv, a_node))
+    {
+      return false;
+    }
+    *a_overflow = branch;
+    return true;
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::PickHilbertBranch(uint64_t a_hilbert, Node *a_node) {
+    // Дочерние узлы упорядочены по LHV, ищем первый с LHV >= a_hilbert
+    int low = 0;
+    int high = a_node->m_count;
+    while(low < high)
+    {
+      int middle = (low + high) / 2;
+      if(a_node->m_branch[middle].m_child->m_lhv < a_hilbert)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    return std::min(low, a_node->m_count - 1);
+  }
+
+  RTREE_TEMPLATE
+  uint64_t RTREE_QUAL::BranchLowKey(const Branch *a_branch) {
+    NodeBase* node = a_branch->m_child;
+    while(node->IsInternalNode())
+    {
+      node = AsInternal(node)->m_branch[0].m_child;
+    }
+    return (node->m_count > 0) ? BranchLhv(&AsLeaf(node)->m_branch[0]) : 0;
+  }
+
+  RTREE_TEMPLATE
+  bool RTREE_QUAL::PackBefore(const PackItem<Branch> &a_left, const PackItem<Branch> &a_right) {
+    if(a_left.m_key != a_right.m_key)
+    {
+      return a_left.m_key < a_right.m_key;
+    }
+    return BranchLowKey(&a_left.m_branch) < BranchLowKey(&a_right.m_branch);
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  bool RTREE_QUAL::InsertSortedBranch(typename NODE::BranchType *a_branch, uint64_t a_hilbert, NODE *a_node) {
+    if(a_node->m_count >= max_nodes)
+    {
+      return false;
+    }
+
+    // Место ищется по наименьшему ключу ветви, LHV узла - по наибольшему
+    uint64_t position = BranchLowKey(a_branch);
+    int low = 0;
+    int high = a_node->m_count;
+    while(low < high)
+    {
+      int middle = (low + high) / 2;
+      if(BranchLhv(&a_node->m_branch[middle]) <= position)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+
+    for(int index = a_node->m_count; index > low; --index)
+    {
+      a_node->m_branch[index] = a_node->m_branch[index - 1];
+    }
+    a_node->m_branch[low] = *a_branch;
+    ++a_node->m_count;
+    a_node->m_lhv = std::max(a_node->m_lhv, a_hilbert);
+
+    return true;
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::HilbertOverflow(Node *a_parent, int a_index, typename NODE::BranchType *a_pending, NodeBase **a_newNode) {
+    HilbertVars<typename NODE::BranchType>* vars = new HilbertVars<typename NODE::BranchType>;
+    NODE* nodes[3];
+    int first = a_index;
+    int siblingCount = 1;
+    int level = a_parent->m_branch[a_index].m_child->level;
+
+    // Соседом берем следующий узел, у последнего - предыдущий
+    if(a_index + 1 < a_parent->m_count)
+    {
+      siblingCount = 2;
+    }
+    else if(a_index > 0)
+    {
+      first = a_index - 1;
+      siblingCount = 2;
+    }
+    for(int index = 0; index < siblingCount; ++index)
+    {
+      MakeWritable(&a_parent->m_branch[first + index].m_child);
+    }
+    GatherSiblings<NODE>(a_parent, first, siblingCount, vars);
+
+    // Вставляем отложенную ветвь на ее место в порядке Гильберта
+    uint64_t hilbert = BranchLowKey(a_pending);
+    int low = 0;
+    int high = vars->m_branchCount;
+    while(low < high)
+    {
+      int middle = (low + high) / 2;
+      if(BranchLhv(&vars->m_branchBuf[middle]) <= hilbert)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    for(int index = vars->m_branchCount; index > low; --index)
+    {
+      vars->m_branchBuf[index] = vars->m_branchBuf[index - 1];
+    }
+    vars->m_branchBuf[low] = *a_pending;
+    ++vars->m_branchCount;
+
+    int nodeCount = siblingCount;
+    for(int index = 0; index < siblingCount; ++index)
+    {
+      nodes[index] = static_cast<NODE*>(a_parent->m_branch[first + index].m_child);
+    }
+
+    // Соседи тоже полны - сплит 2-к-3 (или 1-к-2 для единственного ребенка)
+    *a_newNode = nullptr;
+    if(vars->m_branchCount > siblingCount * max_nodes)
+    {
+      *a_newNode = LocateNode(level);
+      nodes[nodeCount++] = static_cast<NODE*>(*a_newNode);
+    }
+
+    DistributeBranches(vars, nodes, nodeCount);
+    for(int index = 0; index < siblingCount; ++index)
+    {
+      a_parent->m_branch[first + index].m_rect = NodeCover(nodes[index]);
+    }
+
+    delete vars;
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::HilbertUnderflow(Node *a_parent, int a_index) {
+    if(a_parent->m_count < 2)
+    {
+      // Соседей нет, лишний корень уберет RemoveRect
+      a_parent->m_branch[a_index].m_rect = NodeCover(a_parent->m_branch[a_index].m_child);
+      return;
+    }
+
+    HilbertVars<typename NODE::BranchType>* vars = new HilbertVars<typename NODE::BranchType>;
+    int first = (a_index + 1 < a_parent->m_count) ? a_index : a_index - 1;
+    MakeWritable(&a_parent->m_branch[first].m_child);
+    MakeWritable(&a_parent->m_branch[first + 1].m_child);
+    NODE* nodes[2] = {static_cast<NODE*>(a_parent->m_branch[first].m_child),
+                      static_cast<NODE*>(a_parent->m_branch[first + 1].m_child)};
+
+    GatherSiblings<NODE>(a_parent, first, 2, vars);
+    if(vars->m_branchCount > max_nodes)
+    {
+      // Записей хватает на два узла - занимаем у соседа
+      DistributeBranches(vars, nodes, 2);
+      a_parent->m_branch[first].m_rect = NodeCover(nodes[0]);
+      a_parent->m_branch[first + 1].m_rect = NodeCover(nodes[1]);
+    }
+    else
+    {
+      // Сливаем оба узла в первый, второй больше не нужен
+      DistributeBranches(vars, nodes, 1);
+      a_parent->m_branch[first].m_rect = NodeCover(nodes[0]);
+      DisconnectBranch(a_parent, first + 1);
+      delete nodes[1];
+    }
+
+    delete vars;
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::GatherSiblings(Node *a_parent, int a_first, int a_nodeCount, HilbertVars<typename NODE::BranchType> *a_vars) {
+    a_vars->m_branchCount = 0;
+    for(int node = a_first; node < a_first + a_nodeCount; ++node)
+    {
+      NODE* sibling = static_cast<NODE*>(a_parent->m_branch[node].m_child);
+      for(int index = 0; index < sibling->m_count; ++index)
+      {
+        a_vars->m_branchBuf[a_vars->m_branchCount++] = sibling->m_branch[index];
+      }
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename NODE>
+  void RTREE_QUAL::DistributeBranches(HilbertVars<typename NODE::BranchType> *a_vars, NODE **a_nodes, int a_nodeCount) {
+    int taken = 0;
+
+    for(int node = 0; node < a_nodeCount; ++node)
+    {
+      // Поровну, остаток достается последним узлам
+      int share = (a_vars->m_branchCount - taken) / (a_nodeCount - node);
+      NODE* target = a_nodes[node];
+
+      target->m_count = 0;
+      for(int index = 0; index < share; ++index)
+      {
+        target->m_branch[target->m_count++] = a_vars->m_branchBuf[taken++];
+      }
+      target->m_lhv = (target->m_count > 0) ? BranchLhv(&target->m_branch[target->m_count - 1]) : 0;
+    }
+  }
+
+  RTREE_TEMPLATE
+  int RTREE_QUAL::ThreadCount(int a_threadCount) {
+    if(a_threadCount > 0)
+    {
+      return a_threadCount;
+    }
+    return std::max(1, static_cast<int> (std::thread::hardware_concurrency()));
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::LeafItems(const Rect *a_rects, const DATATYPE *a_data, int a_count, int a_threadCount, std::vector<PackItem<LeafBranch>> &a_items) {
+    // Копируем записи кусками, ключ Гильберта считаем здесь же, чтобы не пересчитывать при сравнениях
+    a_items.resize(static_cast<size_t> (a_count));
+    const int chunk = 1 << 14;
+    ParallelFor((a_count + chunk - 1) / chunk, a_threadCount, [&](int a_chunk) {
+      int end = std::min(a_count, (a_chunk + 1) * chunk);
+      for(int index = a_chunk * chunk; index < end; ++index)
+      {
+        PackItem<LeafBranch>& item = a_items[static_cast<size_t> (index)];
+        SetGeometry(&item.m_branch.m_rect, a_rects[index]);
+        item.m_branch.m_data = a_data[index];
+        item.m_key = (m_policy == SplitPolicy::kHilbert) ? HilbertValue(&a_rects[index]) : 0;
+      }
+    });
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::PackLeaves(const Rect *a_rects, const DATATYPE *a_data, int a_count, int a_threadCount, std::vector<PackItem<Branch>> &a_leaves) {
+    std::vector<PackItem<LeafBranch>> items;
+    LeafItems(a_rects, a_data, a_count, a_threadCount, items);
+    PackLevel(items, 0, a_threadCount, a_leaves);
+  }
+
+  RTREE_TEMPLATE
+  void RTREE_QUAL::MergeBatchRec(NodeBase **a_slot, std::vector<PackItem<LeafBranch>> &a_items, int a_threadCount, std::vector<PackItem<Branch>> &a_extra) {
+    if((*a_slot)->IsLeaf())
+    {
+      MergeBranches(a_slot, a_items, a_threadCount, a_extra);
+      return;
+    }
+
+    // Каждая запись идет в то же поддерево, что выбрал бы Insert
+    Node* node = AsInternal(*a_slot);
+    std::vector<std::vector<PackItem<LeafBranch>>> groups(static_cast<size_t> (node->m_count));
+    for(const PackItem<LeafBranch>& item : a_items)
+    {
+      int index;
+      if(m_policy == SplitPolicy::kHilbert)
+      {
+        index = PickHilbertBranch(item.m_key, node);
+      }
+      else
+      {
+        Rect rect = BranchRect(&item.m_branch);
+        index = PickBranch(&rect, node);
+        node->m_branch[index].m_rect = CombineRect(&rect, &(node->m_branch[index].m_rect));
+      }
+      groups[static_cast<size_t> (index)].push_back(item);
+    }
+
+    std::vector<PackItem<Branch>> extra;
+    for(int index = 0; index < static_cast<int> (groups.size()); ++index)
+    {
+      if(groups[static_cast<size_t> (index)].empty())
+      {
+        continue;
+      }
+      MakeWritable(&node->m_branch[index].m_child);
+      MergeBatchRec(&node->m_branch[index].m_child, groups[static_cast<size_t> (index)], a_threadCount, extra);
+      node->m_branch[index].m_rect = NodeCover(node->m_branch[index].m_child);
+      node->m_lhv = std::max(node->m_lhv, node->m_branch[index].m_child->m_lhv);
+    }
+
+    MergeBranches(a_slot, extra, a_threadCount, a_extra);
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  void RTREE_QUAL::MergeBranches(NodeBase **a_slot, std::vector<PackItem<BRANCH>> &a_items, int a_threadCount, std::vector<PackItem<Branch>> &a_extra) {
+    using TargetNode = NodeOf<BRANCH>;
+    TargetNode* node = static_cast<TargetNode*>(*a_slot);
+
+    if(a_items.empty())
+    {
+      return;
+    }
+
+    int count = static_cast<int> (a_items.size());
+    if(node->m_count + count <= max_nodes)
+    {
+      if(m_policy != SplitPolicy::kHilbert)
+      {
+        // Порядок ветвей не важен, просто дописываем
+        for(const PackItem<BRANCH>& item : a_items)
+        {
+          node->m_branch[node->m_count++] = item.m_branch;
+        }
+        return;
+      }
+
+      // kHilbert: ветви узла упорядочены по кривой, сливаем с отсортированными новыми с конца.
+      // Место каждой новой ветви ищется двоичным поиском (как в InsertSortedBranch),
+      // поэтому ключи старых считаются только для проб
+      std::sort(a_items.begin(), a_items.end(), [this](const PackItem<BRANCH>& a_left, const PackItem<BRANCH>& a_right) {
+        return PackBefore(a_left, a_right);
+      });
+      int read = node->m_count;
+      int write = node->m_count + count - 1;
+      for(int item = count - 1; item >= 0; --item)
+      {
+        uint64_t key = BranchLowKey(&a_items[static_cast<size_t> (item)].m_branch);
+        int low = 0;
+        int high = read;
+        while(low < high)
+        {
+          int middle = (low + high) / 2;
+          if(BranchLhv(&node->m_branch[middle]) <= key)
+          {
+            low = middle + 1;
+          }
+          else
+          {
+            high = middle;
+          }
+        }
+        for(int index = read - 1; index >= low; --index)
+        {
+          node->m_branch[write--] = node->m_branch[index];
+        }
+        read = low;
+        node->m_branch[write--] = a_items[static_cast<size_t> (item)].m_branch;
+      }
+      node->m_count += count;
+      node->m_lhv = std::max(node->m_lhv, a_items.back().m_key);
+      return;
+    }
+
+    for(int index = 0; index < node->m_count; ++index)
+    {
+      PackItem<BRANCH> item;
+      item.m_key = (m_policy == SplitPolicy::kHilbert) ? BranchLhv(&node->m_branch[index]) : 0;
+      item.m_branch = node->m_branch[index];
+      a_items.push_back(item);
+    }
+
+    // Узел переполнен: его ветви вместе с новыми упаковываются так же, как в BulkLoad
+    std::vector<PackItem<Branch>> packed;
+    PackLevel(a_items, node->level, a_threadCount, packed);
+    FreeNode(node);
+    *a_slot = packed[0].m_branch.m_child;
+    a_extra.insert(a_extra.end(), packed.begin() + 1, packed.end());
+  }
+
+  RTREE_TEMPLATE
+  template <typename BRANCH>
+  void RTREE_QUAL::PackLevel(std::vector<PackItem<BRANCH>> &a_items, int a_level, int a_threadCount, std::vector<PackItem<Branch>> &a_parents) {
+    using ItemType = PackItem<BRANCH>;
+    size_t count = a_items.size();
+    int nodeCount = static_cast<int> ((count + max_nodes - 1) / max_nodes);
+    ItemType* items = a_items.data();
+
+    // Границы узлов: записи делятся поровну, поэтому каждый узел заполнен не меньше чем на половину
+    std::vector<size_t> nodeCuts(static_cast<size_t> (nodeCount) + 1);
+    for(int node = 0; node <= nodeCount; ++node)
+    {
+      nodeCuts[static_cast<size_t> (node)] = count * static_cast<size_t> (node) / static_cast<size_t> (nodeCount);
+    }
+
+    if(m_policy == SplitPolicy::kHilbert)
+    {
+      // Диапазоны кривой Гильберта: узлам достаются подряд идущие отрезки, внутри узла записи упорядочены
+      auto byKey = [this](const ItemType& a_left, const ItemType& a_right) { return PackBefore(a_left, a_right); };
+      ParallelPartition(items, nodeCuts.data(), 0, nodeCount, byKey, a_threadCount);
+      ParallelFor(nodeCount, a_threadCount, [&](int a_node) {
+        std::sort(items + nodeCuts[static_cast<size_t> (a_node)], items + nodeCuts[static_cast<size_t> (a_node) + 1], byKey);
+      });
+    }
+    else
+    {
+      // Sort-Tile-Recursive: sqrt(P) вертикальных слоев по x, внутри слоя узлы нарезаются по y
+      auto centerX = [](const ItemType& a_left, const ItemType& a_right) {
+        return GeometryCenter(a_left.m_branch.m_rect, 0) < GeometryCenter(a_right.m_branch.m_rect, 0);
+      };
+      auto centerY = [](const ItemType& a_left, const ItemType& a_right) {
+        return GeometryCenter(a_left.m_branch.m_rect, 1) < GeometryCenter(a_right.m_branch.m_rect, 1);
+      };
+
+      int slabCount = static_cast<int> (std::ceil(std::sqrt(static_cast<double> (nodeCount))));
+      std::vector<int> slabFirstNode(static_cast<size_t> (slabCount) + 1);
+      std::vector<size_t> slabCuts(static_cast<size_t> (slabCount) + 1);
+      for(int slab = 0; slab <= slabCount; ++slab)
+      {
+        slabFirstNode[static_cast<size_t> (slab)] = nodeCount * slab / slabCount;
+        slabCuts[static_cast<size_t> (slab)] = nodeCuts[static_cast<size_t> (slabFirstNode[static_cast<size_t> (slab)])];
+      }
+
+      ParallelPartition(items, slabCuts.data(), 0, slabCount, centerX, a_threadCount);
+      int slabThreads = std::max(1, a_threadCount / slabCount);
+      ParallelFor(slabCount, a_threadCount, [&](int a_slab) {
+        ParallelPartition(items, nodeCuts.data(), slabFirstNode[static_cast<size_t> (a_slab)],
+                          slabFirstNode[static_cast<size_t> (a_slab) + 1], centerY, slabThreads);
+      });
+    }
+
+    // Узлы независимы и заполняются параллельно
+    a_parents.resize(static_cast<size_t> (nodeCount));
+    ParallelFor(nodeCount, a_threadCount, [&](int a_node) {
+      NodeOf<BRANCH>* node = static_cast<NodeOf<BRANCH>*>(LocateNode(a_level));
+      for(size_t index = nodeCuts[static_cast<size_t> (a_node)]; index < nodeCuts[static_cast<size_t> (a_node) + 1]; ++index)
+      {
+        node->m_branch[node->m_count++] = items[index].m_branch;
+        node->m_lhv = std::max(node->m_lhv, items[index].m_key);
+      }
+
+      PackItem<Branch>& parent = a_parents[static_cast<size_t> (a_node)];
+      parent.m_key = node->m_lhv;
+      parent.m_branch.m_rect = NodeCover(node);
+      parent.m_branch.m_child = node;
+    });
+  }
+
+  RTREE_TEMPLATE
+  template <typename TASK>
+  void RTREE_QUAL::ParallelFor(int a_count, int a_threadCount, TASK a_task) {
+    int workers = std::min(a_count, a_threadCount);
+    if(workers <= 1)
+    {
+      for(int index = 0; index < a_count; ++index)
+      {
+        a_task(index);
+      }
+      return;
+    }
+
+    // Потоки разбирают задачи по общему счетчику, текущий поток тоже работает
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+      for(int index = next++; index < a_count; index = next++)
+      {
+        a_task(index);
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for(int thread = 1; thread < workers; ++thread)
+    {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for(std::thread& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  RTREE_TEMPLATE
+  template <typename ITEM, typename LESS>
+  void RTREE_QUAL::ParallelPartition(ITEM *a_items, const size_t *a_cuts, int a_first, int a_last, LESS a_less, int a_threadCount) {
+    if(a_last - a_first < 2)
+    {
+      return;
+    }
+
+    int middle = (a_first + a_last) / 2;
+    std::nth_element(a_items + a_cuts[a_first], a_items + a_cuts[middle], a_items + a_cuts[a_last], a_less);
+
+    if(a_threadCount > 1)
+    {
+      std::thread left([=]() { ParallelPartition(a_items, a_cuts, a_first, middle, a_less, a_threadCount / 2); });
+      ParallelPartition(a_items, a_cuts, middle, a_last, a_less, a_threadCount - a_threadCount / 2);
+      left.join();
+    }
+    else
+    {
+      ParallelPartition(a_items, a_cuts, a_first, middle, a_less, 1);
+      ParallelPartition(a_items, a_cuts, middle, a_last, a_less, 1);
+    }
+  }
+
+}  // namespace itis
+
+#undef RTREE_TEMPLATE
+#undef RTREE_QUAL
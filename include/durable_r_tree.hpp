@@ -0,0 +1,726 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data_structure.hpp"
+
+// Журнал упреждающей записи (WAL) и контрольные точки для R-дерева в памяти
+
+namespace itis {
+
+  // Когда журнал сбрасывается на диск (fsync)
+  enum class FsyncPolicy
+  {
+    kAlways,  // после каждого изменения
+    kGroup,   // после группы из a_groupSize изменений или Commit (групповая фиксация)
+    kNever,   // группы пишутся в файл без fsync, надежно только то, что попало в контрольную точку
+  };
+
+  // Контрольная сумма FNV-1a
+  uint64_t DurableChecksum(const void* a_data, size_t a_size);
+
+  // Дописывает буфер файла и дожидается записи на диск
+  bool DurableSync(std::FILE* a_file);
+
+  // Позиционирование и размер для файлов больше 2 ГБ
+  bool DurableSeek(std::FILE* a_file, uint64_t a_offset);
+  bool DurableSize(std::FILE* a_file, uint64_t& a_size);
+
+  // Синхронизирует каталог файла a_path, чтобы создание или переименование файла пережило сбой
+  bool DurableSyncDirectory(const std::string& a_path);
+
+  // Атомарно заменяет a_to файлом a_from
+  bool DurableReplace(const std::string& a_from, const std::string& a_to);
+
+  // R-дерево, изменения которого переживают перезапуск без полной перестройки и пересохранения.
+  // Insert и Remove сначала применяются к дереву, затем дописываются в журнал <a_path>.wal
+  // (запись фиксированного размера: LSN, операция, прямоугольник, данные, контрольная сумма).
+  // Контрольная точка дописывает в <a_path>.pages только узлы, измененные после прошлой точки,
+  // и завершается футером с корнем и LSN; после этого журнал обнуляется.
+  // Измененные узлы находятся через copy-on-write: контрольная точка держит снимок дерева,
+  // поэтому изменение записанного узла создает его копию с m_page = 0.
+  // При открытии загружается последняя полная контрольная точка и проигрывается хвост журнала,
+  // так что время восстановления и объем записи зависят от числа недавних изменений, а не от размера индекса.
+  // Не потокобезопасно, как и BasicRTree
+  template <typename DATATYPE>
+  struct DurableRTree
+  {
+   public:
+    using Rect = itis::Rect;
+    using SplitPolicy = itis::SplitPolicy;
+
+    // Открывает или создает индекс в файлах <a_path>.pages и <a_path>.wal.
+    // a_checkpointInterval - число изменений между автоматическими контрольными точками (0 - только Checkpoint).
+    // a_policy применяется к новому индексу, существующий сохраняет свой режим
+    explicit DurableRTree(const std::string& a_path, FsyncPolicy a_fsync = FsyncPolicy::kGroup, int a_groupSize = 64,
+                          int a_checkpointInterval = 100000, SplitPolicy a_policy = SplitPolicy::kQuadratic);
+    ~DurableRTree();
+
+    DurableRTree(const DurableRTree&) = delete;
+    DurableRTree& operator=(const DurableRTree&) = delete;
+
+    // Индекс открыт и ошибок записи не было. После ошибки изменения продолжают применяться
+    // к дереву в памяти, но больше не сохраняются
+    bool IsOpen() const                            { return !m_failed; }
+
+    // Вставка записи
+    void Insert(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
+
+    // Удаление записи
+    void Remove(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
+
+    // Найти все в прямоугольнике поиска (аналогично BasicRTree::Search)
+    int Search(const int a_min[dimensions], const int a_max[dimensions], bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context);
+
+    // Подсчит элементов данных
+    int Count()                                    { return m_tree.Count(); }
+
+    // Записывает накопленную группу в журнал (с fsync, если политика не kNever)
+    bool Commit();
+
+    // Контрольная точка: записывает измененные узлы и обнуляет журнал
+    bool Checkpoint();
+
+    // Номер последнего изменения и изменения, вошедшего в последнюю контрольную точку
+    uint64_t Lsn() const                           { return m_lsn; }
+    uint64_t CheckpointLsn() const                 { return m_checkpointLsn; }
+
+   protected:
+    using Tree = BasicRTree<DATATYPE>;
+    using NodeBase = typename Tree::NodeBase;
+
+    enum : uint32_t
+    {
+      kPageRecord = 0x45474150,                    // "PAGE"
+      kFooterRecord = 0x52544f46,                  // "FOTR"
+    };
+
+    static constexpr char kInsertOp = 'I';
+    static constexpr char kRemoveOp = 'R';
+
+    // Запись журнала: LSN, операция, m_min, m_max, данные, младшие 32 бита контрольной суммы
+    static constexpr size_t kLogRecordSize = sizeof(uint64_t) + 1 + sizeof(Rect) + sizeof(DATATYPE) + sizeof(uint32_t);
+
+    // Ветвь на странице: прямоугольник и смещение страницы ребенка или данные
+    static constexpr size_t kBranchSize = sizeof(Rect) + sizeof(uint64_t);
+    static constexpr size_t kLeafBranchSize = sizeof(Rect) + sizeof(DATATYPE);
+
+    // Заголовок файла страниц: проверяет, что файл записан деревом с той же раскладкой
+    struct FileHeader
+    {
+      char m_magic[4];
+      int32_t m_dimensions;
+      int32_t m_dataSize;
+      int32_t m_maxNodes;
+    };
+
+    // Файл страниц состоит из записей: страниц узлов и футеров контрольных точек.
+    // Страница пишется после страниц своих детей, поэтому смещения детей всегда меньше
+    struct RecordHeader
+    {
+      uint32_t m_type;
+      uint32_t m_size;                             // Размер записи без заголовка
+    };
+
+    struct PageHeader
+    {
+      int32_t m_level;
+      int32_t m_count;
+      uint64_t m_lhv;
+    };
+
+    struct Footer
+    {
+      uint64_t m_root;                             // Смещение страницы корня
+      uint64_t m_lsn;                              // Последнее изменение, вошедшее в точку
+      int32_t m_policy;
+      int32_t m_reserved;
+      uint64_t m_checksum;                         // Контрольная сумма предыдущих полей
+    };
+
+    template <typename VALUE>
+    static void Append(std::vector<char>& a_buffer, const VALUE& a_value);
+
+    static FileHeader MakeFileHeader();
+
+    // Дописывает изменение в буфер журнала и сбрасывает его по политике
+    void Log(char a_op, const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
+
+    // Записывает буфер журнала в файл, a_sync - с fsync
+    bool WriteLog(bool a_sync);
+
+    // Загружает последнюю контрольную точку и проигрывает журнал
+    bool Recover(SplitPolicy a_policy);
+
+    // Ищет последний целый футер. Возвращает смещение конца футера (или конец заголовка файла)
+    uint64_t FindFooter(uint64_t a_fileSize, Footer& a_footer, bool& a_found);
+
+    bool ReadFooter(uint64_t a_offset, Footer& a_footer);
+
+    // Читает страницу и рекурсивно ее поддерево. a_level < 0 - уровень заранее не известен
+    NodeBase* ReadNode(uint64_t a_offset, uint64_t a_limit, int a_level, std::vector<char>& a_buffer);
+
+    // Проигрывает записи журнала после контрольной точки. a_dirty - в журнале что-то было
+    bool ReplayLog(bool& a_dirty);
+
+    // Пишет контрольную точку: a_full - все узлы в новый файл (со сжатием), иначе только измененные в конец
+    bool WriteCheckpoint(bool a_full);
+
+    // Пишет страницы поддерева после своих детей. Возвращает смещение страницы узла или 0 при ошибке
+    uint64_t WritePages(NodeBase* a_node, std::FILE* a_file, bool a_full, uint64_t& a_end,
+                        std::vector<std::pair<NodeBase*, uint64_t>>& a_written, std::vector<char>& a_buffer);
+
+    // Размер страниц всего дерева
+    static uint64_t LiveBytes(NodeBase* a_node);
+
+    static uint64_t PageSize(NodeBase* a_node);
+
+    Tree m_tree;
+    std::unique_ptr<typename Tree::SnapshotView> m_checkpoint;  // Версия дерева последней контрольной точки
+    std::string m_pagesPath;
+    std::string m_logPath;
+    std::FILE* m_pages;
+    std::FILE* m_log;
+    std::vector<char> m_logBuffer;                 // Группа изменений, еще не записанная в журнал
+    int m_pending;                                 // Число изменений в m_logBuffer
+    FsyncPolicy m_fsync;
+    int m_groupSize;
+    int m_checkpointInterval;
+    uint64_t m_lsn;
+    uint64_t m_checkpointLsn;
+    uint64_t m_pagesEnd;                           // Конец последнего футера в файле страниц
+    bool m_failed;
+  };
+
+  template <typename DATATYPE>
+  DurableRTree<DATATYPE>::DurableRTree(const std::string &a_path, FsyncPolicy a_fsync, int a_groupSize,
+                                       int a_checkpointInterval, SplitPolicy a_policy)
+      : m_tree(a_policy), m_pagesPath(a_path + ".pages"), m_logPath(a_path + ".wal"), m_pages(nullptr), m_log(nullptr),
+        m_pending(0), m_fsync(a_fsync), m_groupSize(std::max(1, a_groupSize)), m_checkpointInterval(a_checkpointInterval),
+        m_lsn(0), m_checkpointLsn(0), m_pagesEnd(0), m_failed(false) {
+    m_failed = !Recover(a_policy);
+  }
+
+  template <typename DATATYPE>
+  DurableRTree<DATATYPE>::~DurableRTree() {
+    Commit();
+    if(m_log)
+    {
+      std::fclose(m_log);
+    }
+    if(m_pages)
+    {
+      std::fclose(m_pages);
+    }
+  }
+
+  template <typename DATATYPE>
+  void DurableRTree<DATATYPE>::Insert(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    m_tree.Insert(a_min, a_max, a_data);
+    Log(kInsertOp, a_min, a_max, a_data);
+  }
+
+  template <typename DATATYPE>
+  void DurableRTree<DATATYPE>::Remove(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    m_tree.Remove(a_min, a_max, a_data);
+    Log(kRemoveOp, a_min, a_max, a_data);
+  }
+
+  template <typename DATATYPE>
+  int DurableRTree<DATATYPE>::Search(const int *a_min, const int *a_max, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) {
+    return m_tree.Search(a_min, a_max, a_resultCallback, a_context);
+  }
+
+  template <typename DATATYPE>
+  bool DurableRTree<DATATYPE>::Commit() {
+    return WriteLog(m_fsync != FsyncPolicy::kNever);
+  }
+
+  template <typename DATATYPE>
+  bool DurableRTree<DATATYPE>::Checkpoint() {
+    if(m_failed)
+    {
+      return false;
+    }
+    // Буфер журнала больше не нужен: точка сохранит все изменения
+    m_logBuffer.clear();
+    m_pending = 0;
+    if(m_lsn == m_checkpointLsn && m_tree.root->m_page != 0)
+    {
+      return true;
+    }
+
+    if(!WriteCheckpoint(false))
+    {
+      return false;
+    }
+
+    // Старые версии узлов копятся в файле: когда они занимают больше живых, файл переписывается
+    if(m_pagesEnd > 2 * LiveBytes(m_tree.root) + (1 << 20))
+    {
+      return WriteCheckpoint(true);
+    }
+    return true;
+  }
+
+  template <typename DATATYPE>
+  template <typename VALUE>
+  void DurableRTree<DATATYPE>::Append(std::vector<char> &a_buffer, const VALUE &a_value) {
+    const char* bytes = reinterpret_cast<const char*> (&a_value);
+    a_buffer.insert(a_buffer.end(), bytes, bytes + sizeof(VALUE));
+  }
+
+  template <typename DATATYPE>
+  typename DurableRTree<DATATYPE>::FileHeader DurableRTree<DATATYPE>::MakeFileHeader() {
+    FileHeader header;
+    std::memcpy(header.m_magic, "RTPG", sizeof(header.m_magic));
+    header.m_dimensions = dimensions;
+    header.m_dataSize = static_cast<int32_t> (sizeof(DATATYPE));
+    header.m_maxNodes = max_nodes;
+    return header;
+  }
+
+  template <typename DATATYPE>
+  void DurableRTree<DATATYPE>::Log(char a_op, const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    if(m_failed)
+    {
+      return;
+    }
+
+    size_t start = m_logBuffer.size();
+    Append(m_logBuffer, ++m_lsn);
+    m_logBuffer.push_back(a_op);
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      Append(m_logBuffer, a_min[axis]);
+    }
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      Append(m_logBuffer, a_max[axis]);
+    }
+    Append(m_logBuffer, a_data);
+    Append(m_logBuffer, static_cast<uint32_t> (DurableChecksum(m_logBuffer.data() + start, m_logBuffer.size() - start)));
+    ++m_pending;
+
+    if(m_fsync == FsyncPolicy::kAlways || m_pending >= m_groupSize)
+    {
+      WriteLog(m_fsync != FsyncPolicy::kNever);
+    }
+    if(m_checkpointInterval > 0 && m_lsn - m_checkpointLsn >= static_cast<uint64_t> (m_checkpointInterval))
+    {
+      Checkpoint();
+    }
+  }
+
+  template <typename DATATYPE>
+  bool DurableRTree<DATATYPE>::WriteLog(bool a_sync) {
+    if(m_failed)
+    {
+      return false;
+    }
+    if(!m_logBuffer.empty())
+    {
+      m_failed |= std::fwrite(m_logBuffer.data(), 1, m_logBuffer.size(), m_log) != m_logBuffer.size();
+      m_logBuffer.clear();
+      m_pending = 0;
+    }
+    m_failed |= a_sync ? !DurableSync(m_log) : std::fflush(m_log) != 0;
+    return !m_failed;
+  }
+
+  template <typename DATATYPE>
+  bool DurableRTree<DATATYPE>::Recover(SplitPolicy a_policy) {
+    m_pages = std::fopen(m_pagesPath.c_str(), "r+b");
+
+    // Файл страниц недописан при создании или отсутствует - индекс новый
+    bool full = true;
+    uint64_t fileSize = 0;
+    FileHeader header;
+    FileHeader expected = MakeFileHeader();
+    if(m_pages && DurableSize(m_pages, fileSize) && fileSize >= sizeof(FileHeader))
+    {
+      if(!DurableSeek(m_pages, 0) || std::fread(&header, sizeof(header), 1, m_pages) != 1 ||
+         std::memcmp(&header, &expected, sizeof(header)) != 0)
+      {
+        return false;
+      }
+
+      Footer footer;
+      bool found = false;
+      m_pagesEnd = FindFooter(fileSize, footer, found);
+      if(found)
+      {
+        std::vector<char> buffer;
+        NodeBase* root = ReadNode(footer.m_root, m_pagesEnd, -1, buffer);
+        if(!root)
+        {
+          return false;
+        }
+        Tree::RemoveAllRec(m_tree.root);
+        m_tree.root = root;
+        m_tree.m_policy = static_cast<SplitPolicy> (footer.m_policy);
+        m_lsn = m_checkpointLsn = footer.m_lsn;
+      }
+      // После сбоя во время контрольной точки за последним футером остался мусор - файл переписывается
+      full = !found || m_pagesEnd != fileSize;
+    }
+    else
+    {
+      m_tree.m_policy = a_policy;
+    }
+    m_checkpoint.reset(new typename Tree::SnapshotView(m_tree.Snapshot()));
+
+    bool dirty = false;
+    if(!ReplayLog(dirty))
+    {
+      return false;
+    }
+
+    if(full || dirty)
+    {
+      // Проигранный журнал сохраняется контрольной точкой, после которой журнал начинается заново
+      if(!WriteCheckpoint(full))
+      {
+        return false;
+      }
+    }
+    else
+    {
+      m_log = std::fopen(m_logPath.c_str(), "ab");
+      if(!m_log || !DurableSyncDirectory(m_logPath))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename DATATYPE>
+  uint64_t DurableRTree<DATATYPE>::FindFooter(uint64_t a_fileSize, Footer &a_footer, bool &a_found) {
+    const uint64_t footerSize = sizeof(RecordHeader) + sizeof(Footer);
+
+    // Обычно файл заканчивается футером последней контрольной точки
+    a_found = a_fileSize >= sizeof(FileHeader) + footerSize && ReadFooter(a_fileSize - footerSize, a_footer);
+    if(a_found)
+    {
+      return a_fileSize;
+    }
+
+    // Иначе - просмотр записей с начала до первой недописанной
+    uint64_t end = sizeof(FileHeader);
+    uint64_t offset = sizeof(FileHeader);
+    RecordHeader record;
+    while(offset + sizeof(RecordHeader) <= a_fileSize && DurableSeek(m_pages, offset) &&
+          std::fread(&record, sizeof(record), 1, m_pages) == 1 && offset + sizeof(RecordHeader) + record.m_size <= a_fileSize)
+    {
+      if(record.m_type == kFooterRecord)
+      {
+        Footer footer;
+        if(!ReadFooter(offset, footer))
+        {
+          break;
+        }
+        a_footer = footer;
+        a_found = true;
+        end = offset + footerSize;
+      }
+      else if(record.m_type != kPageRecord)
+      {
+        break;
+      }
+      offset += sizeof(RecordHeader) + record.m_size;
+    }
+    return end;
+  }
+
+  template <typename DATATYPE>
+  bool DurableRTree<DATATYPE>::ReadFooter(uint64_t a_offset, Footer &a_footer) {
+    RecordHeader record;
+    return DurableSeek(m_pages, a_offset) && std::fread(&record, sizeof(record), 1, m_pages) == 1 &&
+           record.m_type == kFooterRecord && record.m_size == sizeof(Footer) &&
+           std::fread(&a_footer, sizeof(a_footer), 1, m_pages) == 1 &&
+           a_footer.m_checksum == DurableChecksum(&a_footer, offsetof(Footer, m_checksum)) && a_footer.m_root < a_offset;
+  }
+
+  template <typename DATATYPE>
+  typename DurableRTree<DATATYPE>::NodeBase *DurableRTree<DATATYPE>::ReadNode(uint64_t a_offset, uint64_t a_limit, int a_level, std::vector<char> &a_buffer) {
+    RecordHeader record;
+    PageHeader page;
+    if(a_offset < sizeof(FileHeader) || a_offset >= a_limit || !DurableSeek(m_pages, a_offset) ||
+       std::fread(&record, sizeof(record), 1, m_pages) != 1 || record.m_type != kPageRecord ||
+       record.m_size < sizeof(PageHeader) || std::fread(&page, sizeof(page), 1, m_pages) != 1 ||
+       page.m_level < 0 || page.m_count < 0 || page.m_count > max_nodes || (a_level >= 0 && page.m_level != a_level))
+    {
+      return nullptr;
+    }
+    size_t size = static_cast<size_t> (page.m_count) * (page.m_level > 0 ? kBranchSize : kLeafBranchSize);
+    a_buffer.resize(size);
+    if(record.m_size != sizeof(PageHeader) + size || (size > 0 && std::fread(a_buffer.data(), size, 1, m_pages) != 1))
+    {
+      return nullptr;
+    }
+
+    NodeBase* node = m_tree.LocateNode(page.m_level);
+    node->m_lhv = page.m_lhv;
+    const char* position = a_buffer.data();
+    if(node->IsLeaf())
+    {
+      typename Tree::LeafNode* leaf = Tree::AsLeaf(node);
+      for(int index = 0; index < page.m_count; ++index)
+      {
+        std::memcpy(&leaf->m_branch[index].m_rect, position, sizeof(Rect));
+        std::memcpy(&leaf->m_branch[index].m_data, position + sizeof(Rect), sizeof(DATATYPE));
+        position += kLeafBranchSize;
+      }
+      node->m_count = page.m_count;
+    }
+    else
+    {
+      // Смещения детей читаются заранее: рекурсия переиспользует буфер
+      typename Tree::Node* internal = Tree::AsInternal(node);
+      std::vector<uint64_t> children(static_cast<size_t> (page.m_count));
+      for(int index = 0; index < page.m_count; ++index)
+      {
+        std::memcpy(&internal->m_branch[index].m_rect, position, sizeof(Rect));
+        std::memcpy(&children[static_cast<size_t> (index)], position + sizeof(Rect), sizeof(uint64_t));
+        position += kBranchSize;
+      }
+      for(int index = 0; index < page.m_count; ++index)
+      {
+        // Ребенок записан раньше родителя, это же исключает циклы в испорченном файле
+        NodeBase* child = ReadNode(children[static_cast<size_t> (index)], a_offset, page.m_level - 1, a_buffer);
+        if(!child)
+        {
+          Tree::RemoveAllRec(node);
+          return nullptr;
+        }
+        internal->m_branch[index].m_child = child;
+        node->m_count = index + 1;
+      }
+    }
+    node->m_page = a_offset;
+    return node;
+  }
+
+  template <typename DATATYPE>
+  bool DurableRTree<DATATYPE>::ReplayLog(bool &a_dirty) {
+    std::FILE* log = std::fopen(m_logPath.c_str(), "rb");
+    if(!log)
+    {
+      return true;
+    }
+
+    // Непустой журнал (даже с одной недописанной записью) закрывается контрольной точкой,
+    // иначе новые записи легли бы после мусора
+    uint64_t size = 0;
+    if(!DurableSize(log, size) || !DurableSeek(log, 0))
+    {
+      std::fclose(log);
+      return false;
+    }
+    a_dirty = size > 0;
+
+    // Проигрываются записи после контрольной точки подряд до первой недописанной или испорченной
+    char record[kLogRecordSize];
+    while(std::fread(record, kLogRecordSize, 1, log) == 1)
+    {
+      uint32_t checksum;
+      std::memcpy(&checksum, record + kLogRecordSize - sizeof(uint32_t), sizeof(uint32_t));
+      if(checksum != static_cast<uint32_t> (DurableChecksum(record, kLogRecordSize - sizeof(uint32_t))))
+      {
+        break;
+      }
+
+      uint64_t lsn;
+      Rect rect;
+      DATATYPE data;
+      std::memcpy(&lsn, record, sizeof(lsn));
+      char op = record[sizeof(lsn)];
+      std::memcpy(&rect, record + sizeof(lsn) + 1, sizeof(rect));
+      std::memcpy(&data, record + sizeof(lsn) + 1 + sizeof(rect), sizeof(data));
+      if(lsn <= m_checkpointLsn)
+      {
+        continue;  // журнал не успели обнулить после контрольной точки
+      }
+      if(lsn != m_lsn + 1 || (op != kInsertOp && op != kRemoveOp))
+      {
+        break;
+      }
+
+      if(op == kInsertOp)
+      {
+        m_tree.Insert(rect.m_min, rect.m_max, data);
+      }
+      else
+      {
+        m_tree.Remove(rect.m_min, rect.m_max, data);
+      }
+      m_lsn = lsn;
+    }
+    std::fclose(log);
+    return true;
+  }
+
+  template <typename DATATYPE>
+  bool DurableRTree<DATATYPE>::WriteCheckpoint(bool a_full) {
+    std::string path = a_full ? m_pagesPath + ".tmp" : m_pagesPath;
+    std::FILE* file = a_full ? std::fopen(path.c_str(), "w+b") : m_pages;
+    uint64_t end = m_pagesEnd;
+    bool ok = file != nullptr;
+    if(ok && a_full)
+    {
+      FileHeader header = MakeFileHeader();
+      ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+      end = sizeof(FileHeader);
+    }
+    ok = ok && DurableSeek(file, end);
+
+    // Сначала страницы, затем (когда они уже на диске) футер: целый футер ссылается только на целые страницы
+    std::vector<std::pair<NodeBase*, uint64_t>> written;
+    std::vector<char> buffer;
+    uint64_t root = ok ? WritePages(m_tree.root, file, a_full, end, written, buffer) : 0;
+    ok = root != 0 && DurableSync(file);
+    if(ok)
+    {
+      Footer footer;
+      footer.m_root = root;
+      footer.m_lsn = m_lsn;
+      footer.m_policy = static_cast<int32_t> (m_tree.m_policy);
+      footer.m_reserved = 0;
+      footer.m_checksum = DurableChecksum(&footer, offsetof(Footer, m_checksum));
+      RecordHeader record = {kFooterRecord, sizeof(Footer)};
+      ok = std::fwrite(&record, sizeof(record), 1, file) == 1 && std::fwrite(&footer, sizeof(footer), 1, file) == 1 &&
+           DurableSync(file);
+      end += sizeof(record) + sizeof(footer);
+    }
+
+    if(a_full)
+    {
+      if(file)
+      {
+        std::fclose(file);
+      }
+      if(m_pages)
+      {
+        std::fclose(m_pages);
+        m_pages = nullptr;
+      }
+      ok = ok && DurableReplace(path, m_pagesPath);
+      if(!ok)
+      {
+        std::remove(path.c_str());
+      }
+      m_pages = std::fopen(m_pagesPath.c_str(), "r+b");
+      ok = ok && m_pages != nullptr;
+    }
+    if(!ok)
+    {
+      m_failed = true;
+      return false;
+    }
+
+    for(const auto& page : written)
+    {
+      page.first->m_page = page.second;
+    }
+    m_pagesEnd = end;
+    m_checkpointLsn = m_lsn;
+    *m_checkpoint = m_tree.Snapshot();
+
+    // Журнал начинается заново; записи до m_checkpointLsn, если обнуление не дойдет до диска, пропустит восстановление
+    if(m_log)
+    {
+      std::fclose(m_log);
+    }
+    m_log = std::fopen(m_logPath.c_str(), "wb");
+    m_failed = !m_log || !DurableSync(m_log) || !DurableSyncDirectory(m_logPath);
+    return !m_failed;
+  }
+
+  template <typename DATATYPE>
+  uint64_t DurableRTree<DATATYPE>::WritePages(NodeBase *a_node, std::FILE *a_file, bool a_full, uint64_t &a_end,
+                                              std::vector<std::pair<NodeBase*, uint64_t>> &a_written, std::vector<char> &a_buffer) {
+    // Узел не менялся с прошлой точки - его поддерево уже в файле
+    if(!a_full && a_node->m_page != 0)
+    {
+      return a_node->m_page;
+    }
+
+    std::vector<uint64_t> children;
+    if(a_node->IsInternalNode())
+    {
+      typename Tree::Node* internal = Tree::AsInternal(a_node);
+      children.resize(static_cast<size_t> (a_node->m_count));
+      for(int index = 0; index < a_node->m_count; ++index)
+      {
+        children[static_cast<size_t> (index)] = WritePages(internal->m_branch[index].m_child, a_file, a_full, a_end, a_written, a_buffer);
+        if(children[static_cast<size_t> (index)] == 0)
+        {
+          return 0;
+        }
+      }
+    }
+
+    uint64_t size = PageSize(a_node);
+    RecordHeader record = {kPageRecord, static_cast<uint32_t> (size - sizeof(RecordHeader))};
+    PageHeader page = {a_node->level, a_node->m_count, a_node->m_lhv};
+    a_buffer.clear();
+    Append(a_buffer, record);
+    Append(a_buffer, page);
+    if(a_node->IsLeaf())
+    {
+      typename Tree::LeafNode* leaf = Tree::AsLeaf(a_node);
+      for(int index = 0; index < a_node->m_count; ++index)
+      {
+        Append(a_buffer, leaf->m_branch[index].m_rect);
+        Append(a_buffer, leaf->m_branch[index].m_data);
+      }
+    }
+    else
+    {
+      typename Tree::Node* internal = Tree::AsInternal(a_node);
+      for(int index = 0; index < a_node->m_count; ++index)
+      {
+        Append(a_buffer, internal->m_branch[index].m_rect);
+        Append(a_buffer, children[static_cast<size_t> (index)]);
+      }
+    }
+
+    if(std::fwrite(a_buffer.data(), 1, a_buffer.size(), a_file) != a_buffer.size())
+    {
+      return 0;
+    }
+    uint64_t offset = a_end;
+    a_end += size;
+    a_written.emplace_back(a_node, offset);
+    return offset;
+  }
+
+  template <typename DATATYPE>
+  uint64_t DurableRTree<DATATYPE>::LiveBytes(NodeBase *a_node) {
+    uint64_t bytes = PageSize(a_node);
+    if(a_node->IsInternalNode())
+    {
+      typename Tree::Node* internal = Tree::AsInternal(a_node);
+      for(int index = 0; index < a_node->m_count; ++index)
+      {
+        bytes += LiveBytes(internal->m_branch[index].m_child);
+      }
+    }
+    return bytes;
+  }
+
+  template <typename DATATYPE>
+  uint64_t DurableRTree<DATATYPE>::PageSize(NodeBase *a_node) {
+    return sizeof(RecordHeader) + sizeof(PageHeader) +
+           static_cast<uint64_t> (a_node->m_count) * (a_node->IsLeaf() ? kLeafBranchSize : kBranchSize);
+  }
+
+}  // namespace itis
@@ -0,0 +1,227 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "data_structure.hpp"
+
+// Неизменяемое R-дерево в непрерывной памяти для индексов, которые в основном читают
+
+namespace itis {
+
+  // Замороженный образ BasicRTree (только для чтения).
+  // Узлы лежат в одном массиве в порядке обхода в ширину, поэтому дети узла идут подряд,
+  // а вместо указателей хранится 32-битный номер первого ребенка. Прямоугольники узлов
+  // и записи листьев - в отдельных плотных массивах. Search за один проход по детям узла
+  // отбирает пересекающие запрос и сразу запрашивает (prefetch) их память, а затем спускается в них,
+  // подгружая содержимое следующего, чтобы промахи кэша перекрывались
+  template <typename DATATYPE, typename GEOMETRY = Rect>
+  struct FrozenRTree
+  {
+   public:
+    using Rect = itis::Rect;
+    using Point = itis::Point;
+
+    explicit FrozenRTree(const BasicRTree<DATATYPE, GEOMETRY>& a_tree);
+
+    // Найти все в прямоугольнике поиска (аналогично BasicRTree::Search)
+    int Search(const int a_min[dimensions], const int a_max[dimensions], bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context) const;
+
+    // Подсчит элементов данных
+    int Count() const                              { return static_cast<int> (m_data.size()); }
+
+    // Объем памяти под узлы и записи
+    size_t MemorySize() const;
+
+   protected:
+    using Tree = BasicRTree<DATATYPE, GEOMETRY>;
+
+    struct Node
+    {
+      uint32_t m_first;                             // Первый дочерний узел или первая запись листа
+      uint16_t m_count;
+      uint16_t m_level;
+    };
+
+    static void Prefetch(const void* a_address);
+
+    // Запрашивает начало прямоугольников детей или записей узла
+    void PrefetchContents(uint32_t a_node) const;
+
+    // Сколько подходящих детей отбирается за раз перед спуском (буфер на стеке)
+    static constexpr int kChildBatch = 64;
+
+    bool Search(uint32_t a_node, const Rect& a_rect, int& a_foundCount, bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context) const;
+
+    std::vector<Node> m_nodes;                      // Узлы в порядке обхода в ширину
+    std::vector<Rect> m_nodeRects;                  // Покрывающий прямоугольник каждого узла
+    std::vector<GEOMETRY> m_geometry;               // Границы записей листьев
+    std::vector<DATATYPE> m_data;                   // Данные записей листьев
+  };
+
+  // Замораживает дерево: строит его копию в непрерывной памяти
+  template <typename DATATYPE, typename GEOMETRY>
+  FrozenRTree<DATATYPE, GEOMETRY> Freeze(const BasicRTree<DATATYPE, GEOMETRY>& a_tree) {
+    return FrozenRTree<DATATYPE, GEOMETRY>(a_tree);
+  }
+
+  template <typename DATATYPE, typename GEOMETRY>
+  FrozenRTree<DATATYPE, GEOMETRY>::FrozenRTree(const BasicRTree<DATATYPE, GEOMETRY> &a_tree) {
+    typename Tree::NodeBase* root = a_tree.root;
+    if(root->m_count == 0)
+    {
+      return;
+    }
+
+    // Обход в ширину: дети узла current получают номера подряд, начиная с queue.size()
+    std::vector<typename Tree::NodeBase*> queue(1, root);
+    Rect rootRect = root->IsLeaf() ? Tree::BranchRect(&Tree::AsLeaf(root)->m_branch[0])
+                                   : Tree::BranchRect(&Tree::AsInternal(root)->m_branch[0]);
+    for(int index = 1; index < root->m_count; ++index)
+    {
+      Rect rect = root->IsLeaf() ? Tree::BranchRect(&Tree::AsLeaf(root)->m_branch[index])
+                                 : Tree::BranchRect(&Tree::AsInternal(root)->m_branch[index]);
+      for(int axis = 0; axis < dimensions; ++axis)
+      {
+        rootRect.m_min[axis] = std::min(rootRect.m_min[axis], rect.m_min[axis]);
+        rootRect.m_max[axis] = std::max(rootRect.m_max[axis], rect.m_max[axis]);
+      }
+    }
+    m_nodeRects.push_back(rootRect);
+
+    for(size_t current = 0; current < queue.size(); ++current)
+    {
+      typename Tree::NodeBase* source = queue[current];
+      Node node;
+      node.m_count = static_cast<uint16_t> (source->m_count);
+      node.m_level = static_cast<uint16_t> (source->level);
+
+      if(source->IsInternalNode())
+      {
+        typename Tree::Node* internal = Tree::AsInternal(source);
+        node.m_first = static_cast<uint32_t> (queue.size());
+        for(int index = 0; index < internal->m_count; ++index)
+        {
+          queue.push_back(internal->m_branch[index].m_child);
+          m_nodeRects.push_back(internal->m_branch[index].m_rect);
+        }
+      }
+      else
+      {
+        typename Tree::LeafNode* leaf = Tree::AsLeaf(source);
+        node.m_first = static_cast<uint32_t> (m_data.size());
+        for(int index = 0; index < leaf->m_count; ++index)
+        {
+          m_geometry.push_back(leaf->m_branch[index].m_rect);
+          m_data.push_back(leaf->m_branch[index].m_data);
+        }
+      }
+
+      m_nodes.push_back(node);
+    }
+  }
+
+  template <typename DATATYPE, typename GEOMETRY>
+  int FrozenRTree<DATATYPE, GEOMETRY>::Search(const int *a_min, const int *a_max, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) const {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+
+    int foundCount = 0;
+    if(!m_nodes.empty() && Overlap(rect, m_nodeRects[0]))
+    {
+      Search(0, rect, foundCount, a_resultCallback, a_context);
+    }
+
+    return foundCount;
+  }
+
+  template <typename DATATYPE, typename GEOMETRY>
+  size_t FrozenRTree<DATATYPE, GEOMETRY>::MemorySize() const {
+    return m_nodes.size() * sizeof(Node) + m_nodeRects.size() * sizeof(Rect)
+           + m_geometry.size() * sizeof(GEOMETRY) + m_data.size() * sizeof(DATATYPE);
+  }
+
+  template <typename DATATYPE, typename GEOMETRY>
+  void FrozenRTree<DATATYPE, GEOMETRY>::Prefetch(const void *a_address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(a_address);
+#else
+    (void) a_address;
+#endif
+  }
+
+  template <typename DATATYPE, typename GEOMETRY>
+  void FrozenRTree<DATATYPE, GEOMETRY>::PrefetchContents(uint32_t a_node) const {
+    const Node& node = m_nodes[a_node];
+    if(node.m_level > 0)
+    {
+      Prefetch(&m_nodeRects[node.m_first]);
+    }
+    else
+    {
+      Prefetch(&m_geometry[node.m_first]);
+    }
+  }
+
+  template <typename DATATYPE, typename GEOMETRY>
+  bool FrozenRTree<DATATYPE, GEOMETRY>::Search(uint32_t a_node, const Rect &a_rect, int &a_foundCount, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) const {
+    const Node& node = m_nodes[a_node];
+    uint32_t end = node.m_first + node.m_count;
+
+    if(node.m_level > 0) // Это внутренний узел в дереве
+    {
+      // Каждый ребенок проверяется один раз: подходящие запоминаем, сразу запрашивая их заголовки,
+      // и спускаемся в них, когда буфер заполнится или дети кончатся
+      uint32_t children[kChildBatch];
+      uint32_t index = node.m_first;
+      while(index < end)
+      {
+        int count = 0;
+        for(; index < end && count < kChildBatch; ++index)
+        {
+          if(Overlap(a_rect, m_nodeRects[index]))
+          {
+            children[count++] = index;
+            Prefetch(&m_nodes[index]);
+          }
+        }
+
+        for(int child = 0; child < count; ++child)
+        {
+          // Пока идет обход ребенка, подгружается начало следующего
+          if(child + 1 < count)
+          {
+            PrefetchContents(children[child + 1]);
+          }
+
+          if(!Search(children[child], a_rect, a_foundCount, a_resultCallback, a_context))
+          {
+            return false;
+          }
+        }
+      }
+    }
+    else // Лист
+    {
+      for(uint32_t index = node.m_first; index < end; ++index)
+      {
+        if(Overlap(a_rect, m_geometry[index]))
+        {
+          ++a_foundCount;
+          if(a_resultCallback && !a_resultCallback(m_data[index], a_context))
+          {
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+}  // namespace itis
@@ -0,0 +1,411 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "data_structure.hpp"
+
+// Разбиение пространства между несколькими независимыми R-деревьями
+
+namespace itis {
+
+  // Индекс из нескольких BasicRTree (шардов), каждый под своей блокировкой чтения-записи.
+  // Пространство делится k-d разбиением по медианам центров из выборки данных
+  // (без выборки - пополам по середине области, т.е. равномерной сеткой).
+  // Запись попадает в шард, которому принадлежит центр ее прямоугольника;
+  // Search опрашивает только шарды, чей охват пересекает запрос, на постоянном пуле потоков
+  // (один-два шарда - прямо в вызывающем потоке), и не мешает другим Search.
+  // Remove должен получать тот же прямоугольник, что и Insert
+  template <typename DATATYPE>
+  struct ShardedRTree
+  {
+   public:
+    using Rect = itis::Rect;
+    using SplitPolicy = itis::SplitPolicy;
+
+    // a_sample - выборка прямоугольников для выбора разбиения (может быть пустой),
+    // a_shardCount - число шардов, a_threadCount - потоки для Search вместе с вызывающим (0 - по числу ядер)
+    ShardedRTree(const Rect* a_sample, int a_sampleCount, int a_shardCount,
+                 SplitPolicy a_policy = SplitPolicy::kQuadratic, int a_threadCount = 0);
+
+    // Останавливает пул потоков
+    ~ShardedRTree();
+
+    // Вставка записи. Блокирует только один шард
+    void Insert(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
+
+    // Удаление записи. Блокирует только один шард
+    void Remove(const int a_min[dimensions], const int a_max[dimensions], const DATATYPE& a_data);
+
+    // Найти все в прямоугольнике поиска (аналогично BasicRTree::Search).
+    // Шарды просматриваются параллельно под разделяемой блокировкой, a_resultCallback вызывается последовательно в текущем потоке
+    int Search(const int a_min[dimensions], const int a_max[dimensions], bool a_resultCallback(DATATYPE a_data, void* a_context), void* a_context);
+
+    // Подсчит элементов данных
+    int Count();
+
+    // Число шардов
+    int ShardCount() const                         { return static_cast<int> (m_shards.size()); }
+
+   protected:
+    struct Shard
+    {
+      explicit Shard(SplitPolicy a_policy) : m_tree(a_policy), m_empty(true) {}
+
+      BasicRTree<DATATYPE> m_tree;
+      std::shared_mutex m_mutex;                   // Search - разделяемо, Insert и Remove - монопольно
+      Rect m_extent;                               // Охват записей шарда (после удалений не сжимается)
+      bool m_empty;
+    };
+
+    // Поиск по нескольким шардам, который разбирают вызывающий поток и потоки пула
+    struct Batch
+    {
+      const int* m_min;
+      const int* m_max;
+      Shard* const* m_targets;
+      std::vector<DATATYPE>* m_results;
+      int m_count;
+      std::atomic<int> m_next;                     // Следующий не взятый шард
+      int m_workers;                               // Потоки пула, работающие с поиском (под m_poolMutex)
+    };
+
+    // Узел k-d разбиения. Дети с отрицательным номером - шарды (~номер шарда)
+    struct Split
+    {
+      int m_axis;
+      int64_t m_value;                             // Удвоенная координата: центры сравниваются как min + max
+      int m_left;
+      int m_right;
+    };
+
+    // Строит поддерево разбиения на a_shardCount шардов для центров a_centers[a_first, a_last)
+    // внутри области [a_low, a_high] (удвоенные координаты). Возвращает номер узла или ~шард
+    int BuildSplits(std::vector<int64_t>& a_centers, size_t a_first, size_t a_last, int a_shardCount,
+                    const int64_t a_low[dimensions], const int64_t a_high[dimensions], SplitPolicy a_policy);
+
+    // Шард, которому принадлежит центр прямоугольника
+    Shard* Locate(const int a_min[dimensions], const int a_max[dimensions]);
+
+    // Собирает результаты поиска в шарде
+    static bool CollectResult(DATATYPE a_data, void* a_context);
+
+    // Берет шарды поиска, пока они не кончатся
+    static void RunBatch(Batch& a_batch);
+
+    // Цикл потока пула: ждет поиски из очереди и помогает их выполнить
+    void WorkerLoop();
+
+    std::vector<Split> m_splits;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    int m_root;                                    // Корень разбиения (или ~шард, если шард один)
+
+    // Пул потоков для Search, общий для всех одновременных запросов
+    std::vector<std::thread> m_workers;
+    std::mutex m_poolMutex;
+    std::condition_variable m_poolWake;            // Появился поиск или пул останавливается
+    std::condition_variable m_batchDone;           // Поток пула закончил свою часть поиска
+    std::deque<Batch*> m_batches;                  // Поиски, в которых еще есть не взятые шарды
+    bool m_stopping;
+  };
+
+  template <typename DATATYPE>
+  ShardedRTree<DATATYPE>::ShardedRTree(const Rect *a_sample, int a_sampleCount, int a_shardCount,
+                                       SplitPolicy a_policy, int a_threadCount)
+      : m_stopping(false) {
+    // Центры выборки по осям подряд: a_centers[i * dimensions + axis]
+    std::vector<int64_t> centers;
+    centers.reserve(static_cast<size_t> (std::max(0, a_sampleCount)) * dimensions);
+    for(int index = 0; index < a_sampleCount; ++index)
+    {
+      for(int axis = 0; axis < dimensions; ++axis)
+      {
+        centers.push_back(static_cast<int64_t> (a_sample[index].m_min[axis]) + a_sample[index].m_max[axis]);
+      }
+    }
+
+    int64_t low[dimensions];
+    int64_t high[dimensions];
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      low[axis] = 2 * static_cast<int64_t> (INT32_MIN);
+      high[axis] = 2 * static_cast<int64_t> (INT32_MAX);
+    }
+    m_root = BuildSplits(centers, 0, static_cast<size_t> (std::max(0, a_sampleCount)), std::max(1, a_shardCount), low, high, a_policy);
+
+    // Вызывающий Search поток тоже работает, поэтому пулу нужно на один поток меньше.
+    // Больше потоков, чем шардов, одному запросу не пригодится
+    int workers = std::min(BasicRTree<DATATYPE>::ThreadCount(a_threadCount), static_cast<int> (m_shards.size())) - 1;
+    for(int worker = 0; worker < workers; ++worker)
+    {
+      m_workers.emplace_back(&ShardedRTree::WorkerLoop, this);
+    }
+  }
+
+  template <typename DATATYPE>
+  ShardedRTree<DATATYPE>::~ShardedRTree() {
+    {
+      std::lock_guard<std::mutex> lock(m_poolMutex);
+      m_stopping = true;
+    }
+    m_poolWake.notify_all();
+    for(std::thread& worker : m_workers)
+    {
+      worker.join();
+    }
+  }
+
+  template <typename DATATYPE>
+  int ShardedRTree<DATATYPE>::BuildSplits(std::vector<int64_t> &a_centers, size_t a_first, size_t a_last, int a_shardCount,
+                                          const int64_t *a_low, const int64_t *a_high, SplitPolicy a_policy) {
+    if(a_shardCount == 1)
+    {
+      m_shards.emplace_back(new Shard(a_policy));
+      return ~static_cast<int> (m_shards.size() - 1);
+    }
+
+    // Делим по оси с наибольшим разбросом центров, без выборки - по самой длинной стороне области
+    int axis = 0;
+    int64_t spread = -1;
+    for(int current = 0; current < dimensions; ++current)
+    {
+      int64_t low = a_low[current];
+      int64_t high = a_high[current];
+      if(a_last - a_first >= 2)
+      {
+        low = high = a_centers[a_first * dimensions + static_cast<size_t> (current)];
+        for(size_t index = a_first; index < a_last; ++index)
+        {
+          low = std::min(low, a_centers[index * dimensions + static_cast<size_t> (current)]);
+          high = std::max(high, a_centers[index * dimensions + static_cast<size_t> (current)]);
+        }
+      }
+      if(high - low > spread)
+      {
+        spread = high - low;
+        axis = current;
+      }
+    }
+
+    // Шарды делятся между половинами пропорционально, граница - соответствующая квантиль выборки
+    int leftShards = a_shardCount / 2;
+    size_t middle = a_first + (a_last - a_first) * static_cast<size_t> (leftShards) / static_cast<size_t> (a_shardCount);
+    int64_t value = a_low[axis] + (a_high[axis] - a_low[axis]) * leftShards / a_shardCount;
+    if(a_last - a_first >= 2)
+    {
+      // Сортируем номера записей по центру и переставляем центры целиком
+      std::vector<size_t> order(a_last - a_first);
+      for(size_t index = 0; index < order.size(); ++index)
+      {
+        order[index] = a_first + index;
+      }
+      std::nth_element(order.begin(), order.begin() + static_cast<std::ptrdiff_t> (middle - a_first), order.end(),
+                       [&](size_t a_left, size_t a_right) {
+                         return a_centers[a_left * dimensions + static_cast<size_t> (axis)] < a_centers[a_right * dimensions + static_cast<size_t> (axis)];
+                       });
+      std::vector<int64_t> sorted;
+      sorted.reserve(order.size() * dimensions);
+      for(size_t index : order)
+      {
+        sorted.insert(sorted.end(), a_centers.begin() + static_cast<std::ptrdiff_t> (index * dimensions),
+                      a_centers.begin() + static_cast<std::ptrdiff_t> ((index + 1) * dimensions));
+      }
+      std::copy(sorted.begin(), sorted.end(), a_centers.begin() + static_cast<std::ptrdiff_t> (a_first * dimensions));
+      value = a_centers[middle * dimensions + static_cast<size_t> (axis)];
+    }
+
+    // Центры меньше value уходят влево
+    int64_t leftHigh[dimensions];
+    int64_t rightLow[dimensions];
+    for(int current = 0; current < dimensions; ++current)
+    {
+      leftHigh[current] = a_high[current];
+      rightLow[current] = a_low[current];
+    }
+    leftHigh[axis] = value - 1;
+    rightLow[axis] = value;
+
+    int node = static_cast<int> (m_splits.size());
+    m_splits.push_back(Split{axis, value, 0, 0});
+    int left = BuildSplits(a_centers, a_first, middle, leftShards, a_low, leftHigh, a_policy);
+    int right = BuildSplits(a_centers, middle, a_last, a_shardCount - leftShards, rightLow, a_high, a_policy);
+    m_splits[static_cast<size_t> (node)].m_left = left;
+    m_splits[static_cast<size_t> (node)].m_right = right;
+    return node;
+  }
+
+  template <typename DATATYPE>
+  typename ShardedRTree<DATATYPE>::Shard *ShardedRTree<DATATYPE>::Locate(const int *a_min, const int *a_max) {
+    int node = m_root;
+    while(node >= 0)
+    {
+      const Split& split = m_splits[static_cast<size_t> (node)];
+      int64_t center = static_cast<int64_t> (a_min[split.m_axis]) + a_max[split.m_axis];
+      node = (center < split.m_value) ? split.m_left : split.m_right;
+    }
+    return m_shards[static_cast<size_t> (~node)].get();
+  }
+
+  template <typename DATATYPE>
+  void ShardedRTree<DATATYPE>::Insert(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    Shard* shard = Locate(a_min, a_max);
+    std::unique_lock<std::shared_mutex> lock(shard->m_mutex);
+
+    shard->m_tree.Insert(a_min, a_max, a_data);
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      if(shard->m_empty || a_min[axis] < shard->m_extent.m_min[axis])
+      {
+        shard->m_extent.m_min[axis] = a_min[axis];
+      }
+      if(shard->m_empty || a_max[axis] > shard->m_extent.m_max[axis])
+      {
+        shard->m_extent.m_max[axis] = a_max[axis];
+      }
+    }
+    shard->m_empty = false;
+  }
+
+  template <typename DATATYPE>
+  void ShardedRTree<DATATYPE>::Remove(const int *a_min, const int *a_max, const DATATYPE &a_data) {
+    Shard* shard = Locate(a_min, a_max);
+    std::unique_lock<std::shared_mutex> lock(shard->m_mutex);
+
+    shard->m_tree.Remove(a_min, a_max, a_data);
+  }
+
+  template <typename DATATYPE>
+  int ShardedRTree<DATATYPE>::Search(const int *a_min, const int *a_max, bool (*a_resultCallback)(DATATYPE, void *), void *a_context) {
+    Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+
+    // Шарды, охват которых пересекает запрос
+    std::vector<Shard*> targets;
+    for(const std::unique_ptr<Shard>& shard : m_shards)
+    {
+      std::shared_lock<std::shared_mutex> lock(shard->m_mutex);
+      if(!shard->m_empty && itis::Overlap(rect, shard->m_extent))
+      {
+        targets.push_back(shard.get());
+      }
+    }
+
+    std::vector<std::vector<DATATYPE>> results(targets.size());
+    Batch batch;
+    batch.m_min = a_min;
+    batch.m_max = a_max;
+    batch.m_targets = targets.data();
+    batch.m_results = results.data();
+    batch.m_count = static_cast<int> (targets.size());
+    batch.m_next = 0;
+    batch.m_workers = 0;
+
+    // Один-два шарда быстрее обойти самому, чем будить пул
+    if(targets.size() <= 2 || m_workers.empty())
+    {
+      RunBatch(batch);
+    }
+    else
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        m_batches.push_back(&batch);
+      }
+      m_poolWake.notify_all();
+      RunBatch(batch);
+
+      // Все шарды взяты; дожидаемся потоков пула, которые еще ищут в своих
+      std::unique_lock<std::mutex> lock(m_poolMutex);
+      typename std::deque<Batch*>::iterator queued = std::find(m_batches.begin(), m_batches.end(), &batch);
+      if(queued != m_batches.end())
+      {
+        m_batches.erase(queued);
+      }
+      m_batchDone.wait(lock, [&batch]() { return batch.m_workers == 0; });
+    }
+
+    int foundCount = 0;
+    for(const std::vector<DATATYPE>& shardResults : results)
+    {
+      for(const DATATYPE& data : shardResults)
+      {
+        ++foundCount;
+        if(a_resultCallback && !a_resultCallback(data, a_context))
+        {
+          return foundCount;
+        }
+      }
+    }
+    return foundCount;
+  }
+
+  template <typename DATATYPE>
+  int ShardedRTree<DATATYPE>::Count() {
+    int count = 0;
+    for(const std::unique_ptr<Shard>& shard : m_shards)
+    {
+      std::shared_lock<std::shared_mutex> lock(shard->m_mutex);
+      count += shard->m_tree.Count();
+    }
+    return count;
+  }
+
+  template <typename DATATYPE>
+  bool ShardedRTree<DATATYPE>::CollectResult(DATATYPE a_data, void *a_context) {
+    static_cast<std::vector<DATATYPE>*>(a_context)->push_back(a_data);
+    return true;
+  }
+
+  template <typename DATATYPE>
+  void ShardedRTree<DATATYPE>::RunBatch(Batch &a_batch) {
+    for(int index = a_batch.m_next++; index < a_batch.m_count; index = a_batch.m_next++)
+    {
+      Shard* shard = a_batch.m_targets[index];
+      std::shared_lock<std::shared_mutex> lock(shard->m_mutex);
+      shard->m_tree.Search(a_batch.m_min, a_batch.m_max, CollectResult, &a_batch.m_results[index]);
+    }
+  }
+
+  template <typename DATATYPE>
+  void ShardedRTree<DATATYPE>::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(m_poolMutex);
+    while(true)
+    {
+      m_poolWake.wait(lock, [this]() { return m_stopping || !m_batches.empty(); });
+      if(m_batches.empty())
+      {
+        return;
+      }
+
+      Batch* batch = m_batches.front();
+      ++batch->m_workers;
+      lock.unlock();
+      RunBatch(*batch);
+      lock.lock();
+
+      // Шарды кончились: убираем поиск из очереди, если его не убрал кто-то раньше
+      typename std::deque<Batch*>::iterator queued = std::find(m_batches.begin(), m_batches.end(), batch);
+      if(queued != m_batches.end())
+      {
+        m_batches.erase(queued);
+      }
+      if(--batch->m_workers == 0)
+      {
+        m_batchDone.notify_all();
+      }
+    }
+  }
+
+}  // namespace itis
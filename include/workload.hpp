@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "data_structure.hpp"
+
+// Файлы наборов данных и трасс запросов для генератора (dataset) и воспроизведения (benchmark)
+
+namespace itis {
+
+  // Операция трассы
+  enum class WorkloadOp : char
+  {
+    kInsert = 'I',
+    kRemove = 'R',
+    kSearch = 'S',
+  };
+
+  // Строка набора данных или трассы. Для kSearch m_id не используется
+  struct WorkloadRecord
+  {
+    WorkloadOp m_op;
+    int m_id;
+    Rect m_rect;
+  };
+
+  // Формат файла.
+  // CSV: строка "<id>,<x_min>,<y_min>,<x_max>,<y_max>" (как у dataset/generate_csv_dataset.py) - вставка,
+  // в трассах перед ней стоит буква операции: "S,0,..." - поиск, "R,<id>,..." - удаление.
+  // Двоичный: заголовок "RTWL", число измерений (int32), затем записи из
+  // 2 + 2 * dimensions чисел int32 (операция, id, m_min, m_max) в порядке байтов машины
+  enum class WorkloadFormat
+  {
+    kCsv,
+    kBinary,
+  };
+
+  // Последовательная запись в файл через буфер: наборы до сотен миллионов строк не держатся в памяти
+  struct WorkloadWriter
+  {
+   public:
+    WorkloadWriter(const std::string& a_path, WorkloadFormat a_format);
+    ~WorkloadWriter();
+
+    WorkloadWriter(const WorkloadWriter&) = delete;
+    WorkloadWriter& operator=(const WorkloadWriter&) = delete;
+
+    // Удалось ли открыть файл
+    bool IsOpen() const                            { return m_file != nullptr; }
+
+    void Write(const WorkloadRecord& a_record);
+
+    // Дописывает буфер и закрывает файл. false - ошибка записи
+    bool Close();
+
+   protected:
+    void FlushBuffer();
+
+    std::FILE* m_file;
+    WorkloadFormat m_format;
+    std::vector<char> m_buffer;
+    bool m_failed;
+  };
+
+  // Последовательное чтение; формат определяется по заголовку файла
+  struct WorkloadReader
+  {
+   public:
+    explicit WorkloadReader(const std::string& a_path);
+    ~WorkloadReader();
+
+    WorkloadReader(const WorkloadReader&) = delete;
+    WorkloadReader& operator=(const WorkloadReader&) = delete;
+
+    // Удалось ли открыть файл и прочитать заголовок
+    bool IsOpen() const                            { return m_file != nullptr; }
+
+    // Читает следующую запись. false - конец файла или ошибка (см. Failed)
+    bool Read(WorkloadRecord& a_record);
+
+    // Дочитывает до a_maxCount записей в конец a_records, возвращает число прочитанных
+    size_t Read(std::vector<WorkloadRecord>& a_records, size_t a_maxCount);
+
+    // Чтение прервано некорректной строкой или записью
+    bool Failed() const                            { return m_failed; }
+
+   protected:
+    bool ReadCsv(WorkloadRecord& a_record);
+
+    std::FILE* m_file;
+    WorkloadFormat m_format;
+    bool m_failed;
+  };
+
+}  // namespace itis
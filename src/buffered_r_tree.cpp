@@ -0,0 +1,8 @@
+#include "buffered_r_tree.hpp"
+
+namespace itis {
+
+  // Обертка целиком в заголовке; здесь она собирается для int вместе с библиотекой
+  template struct BufferedRTree<int>;
+
+}  // namespace itis
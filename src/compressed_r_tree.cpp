@@ -0,0 +1,338 @@
+#include "compressed_r_tree.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace itis {
+  template <typename OFFSET>
+  CompressedRTree<OFFSET>::CompressedRTree(const RTree &a_tree, bool a_keepExact) : m_keepExact(a_keepExact) {
+    static_assert(std::numeric_limits<OFFSET>::is_integer && !std::numeric_limits<OFFSET>::is_signed,
+                  "Смещения должны быть беззнаковыми целыми");
+
+    RTree::NodeBase* root = a_tree.root;
+    if(root->m_count == 0)
+    {
+      return;
+    }
+
+    m_rootRect = root->IsLeaf() ? Cover(RTree::AsLeaf(root)) : Cover(RTree::AsInternal(root));
+
+    // Обход в ширину: дети каждого узла получают подряд идущие номера.
+    // Рамкой для детей служит восстановленный (а не точный) прямоугольник узла - ровно то, что увидит Search
+    std::vector<RTree::NodeBase*> queue(1, root);
+    std::vector<RTree::Rect> frames(1, m_rootRect);
+    uint32_t entries = 0;
+
+    for(size_t current = 0; current < queue.size(); ++current)
+    {
+      RTree::NodeBase* source = queue[current];
+      RTree::Rect frame = frames[current];
+      Node node;
+
+      node.m_count = static_cast<uint16_t> (source->m_count);
+      node.m_level = static_cast<uint16_t> (source->level);
+      node.m_rectSlot = static_cast<uint32_t> (m_coords.size() / (2 * dimensions));
+      node.m_idOffset = static_cast<uint32_t> (m_ids.size());
+      node.m_residualOffset = static_cast<uint32_t> (m_residuals.size());
+      node.m_residualBits = 0;
+
+      if(source->IsInternalNode())
+      {
+        RTree::Node* internal = RTree::AsInternal(source);
+        node.m_first = static_cast<uint32_t> (queue.size());
+        for(int index = 0; index < internal->m_count; ++index)
+        {
+          size_t slot = m_coords.size();
+          m_coords.resize(slot + 2 * dimensions);
+          Quantize(internal->m_branch[index].m_rect, frame, &m_coords[slot]);
+
+          queue.push_back(internal->m_branch[index].m_child);
+          frames.push_back(Dequantize(&m_coords[slot], frame));
+        }
+      }
+      else
+      {
+        // Сортируем записи листа по идентификатору, чтобы разности были маленькими
+        RTree::LeafNode* leaf = RTree::AsLeaf(source);
+        std::vector<int> order(static_cast<size_t> (source->m_count));
+        for(int index = 0; index < source->m_count; ++index)
+        {
+          order[static_cast<size_t> (index)] = index;
+        }
+        std::sort(order.begin(), order.end(), [leaf](int a_left, int a_right) {
+          return leaf->m_branch[a_left].m_data < leaf->m_branch[a_right].m_data;
+        });
+
+        node.m_first = entries;
+        int64_t previous = 0;
+        std::vector<uint32_t> residuals;
+        uint32_t largest = 0;
+        for(size_t index = 0; index < order.size(); ++index)
+        {
+          const RTree::LeafBranch& branch = leaf->m_branch[order[index]];
+
+          size_t slot = m_coords.size();
+          m_coords.resize(slot + 2 * dimensions);
+          Quantize(branch.m_rect, frame, &m_coords[slot]);
+
+          if(index == 0)
+          {
+            // Первый идентификатор может быть отрицательным - zigzag
+            int64_t id = branch.m_data;
+            WriteVarint((static_cast<uint64_t> (id) << 1) ^ static_cast<uint64_t> (id >> 63), m_ids);
+          }
+          else
+          {
+            WriteVarint(static_cast<uint64_t> (branch.m_data - previous), m_ids);
+          }
+          previous = branch.m_data;
+
+          if(m_keepExact)
+          {
+            // Восстановленный прямоугольник содержит точный, поэтому поправки неотрицательны
+            RTree::Rect rounded = Dequantize(&m_coords[slot], frame);
+            for(int axis = 0; axis < dimensions; ++axis)
+            {
+              residuals.push_back(static_cast<uint32_t> (static_cast<int64_t> (branch.m_rect.m_min[axis]) - rounded.m_min[axis]));
+            }
+            for(int axis = 0; axis < dimensions; ++axis)
+            {
+              residuals.push_back(static_cast<uint32_t> (static_cast<int64_t> (rounded.m_max[axis]) - branch.m_rect.m_max[axis]));
+            }
+            for(size_t value = residuals.size() - 2 * dimensions; value < residuals.size(); ++value)
+            {
+              largest = std::max(largest, residuals[value]);
+            }
+          }
+          ++entries;
+        }
+
+        while((static_cast<uint64_t> (largest) >> node.m_residualBits) != 0)
+        {
+          ++node.m_residualBits;
+        }
+        if(node.m_residualBits > 0)
+        {
+          m_residuals.resize(m_residuals.size() + (residuals.size() * node.m_residualBits + 7) / 8, 0);
+          for(size_t value = 0; value < residuals.size(); ++value)
+          {
+            WriteBits(residuals[value], node.m_residualBits, value * node.m_residualBits, &m_residuals[node.m_residualOffset]);
+          }
+        }
+      }
+
+      m_nodes.push_back(node);
+    }
+  }
+
+  template <typename OFFSET>
+  template <typename NODE>
+  RTree::Rect CompressedRTree<OFFSET>::Cover(const NODE *a_node) {
+    RTree::Rect rect = a_node->m_branch[0].m_rect;
+    for(int index = 1; index < a_node->m_count; ++index)
+    {
+      for(int axis = 0; axis < dimensions; ++axis)
+      {
+        rect.m_min[axis] = std::min(rect.m_min[axis], a_node->m_branch[index].m_rect.m_min[axis]);
+        rect.m_max[axis] = std::max(rect.m_max[axis], a_node->m_branch[index].m_rect.m_max[axis]);
+      }
+    }
+    return rect;
+  }
+
+  template <typename OFFSET>
+  int CompressedRTree<OFFSET>::Search(const int *a_min, const int *a_max, bool (*a_resultCallback)(int, void *), void *a_context) const {
+    RTree::Rect rect;
+
+    for(int axis=0; axis < dimensions; ++axis)
+    {
+      rect.m_min[axis] = a_min[axis];
+      rect.m_max[axis] = a_max[axis];
+    }
+
+    int foundCount = 0;
+    if(!m_nodes.empty())
+    {
+      Search(0, m_rootRect, rect, foundCount, a_resultCallback, a_context);
+    }
+
+    return foundCount;
+  }
+
+  template <typename OFFSET>
+  size_t CompressedRTree<OFFSET>::CompressedSize() const {
+    return m_nodes.size() * sizeof(Node) + m_coords.size() * sizeof(OFFSET) + m_ids.size() + m_residuals.size();
+  }
+
+  template <typename OFFSET>
+  size_t CompressedRTree<OFFSET>::ExactSize() const {
+    return m_residuals.size();
+  }
+
+  template <typename OFFSET>
+  void CompressedRTree<OFFSET>::Quantize(const RTree::Rect &a_rect, const RTree::Rect &a_frame, OFFSET *a_coords) {
+    const int64_t scale = std::numeric_limits<OFFSET>::max();
+
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      int64_t width = static_cast<int64_t> (a_frame.m_max[axis]) - a_frame.m_min[axis];
+      int64_t low = static_cast<int64_t> (a_rect.m_min[axis]) - a_frame.m_min[axis];
+      int64_t high = static_cast<int64_t> (a_rect.m_max[axis]) - a_frame.m_min[axis];
+
+      if(width == 0)
+      {
+        a_coords[axis] = 0;
+        a_coords[dimensions + axis] = 0;
+      }
+      else
+      {
+        // Минимум округляем вниз, максимум вверх
+        a_coords[axis] = static_cast<OFFSET> (low * scale / width);
+        a_coords[dimensions + axis] = static_cast<OFFSET> ((high * scale + width - 1) / width);
+      }
+    }
+  }
+
+  template <typename OFFSET>
+  RTree::Rect CompressedRTree<OFFSET>::Dequantize(const OFFSET *a_coords, const RTree::Rect &a_frame) {
+    const int64_t scale = std::numeric_limits<OFFSET>::max();
+    RTree::Rect rect;
+
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      int64_t width = static_cast<int64_t> (a_frame.m_max[axis]) - a_frame.m_min[axis];
+      int64_t low = a_coords[axis] * width / scale;
+      int64_t high = (a_coords[dimensions + axis] * width + scale - 1) / scale;
+
+      rect.m_min[axis] = static_cast<int> (a_frame.m_min[axis] + low);
+      rect.m_max[axis] = static_cast<int> (a_frame.m_min[axis] + high);
+    }
+    return rect;
+  }
+
+  template <typename OFFSET>
+  void CompressedRTree<OFFSET>::WriteBits(uint32_t a_value, int a_bits, uint64_t a_bit, uint8_t *a_out) {
+    for(int written = 0; written < a_bits; ++written, ++a_bit)
+    {
+      if((a_value >> written) & 1u)
+      {
+        a_out[a_bit >> 3] = static_cast<uint8_t> (a_out[a_bit >> 3] | (1u << (a_bit & 7)));
+      }
+    }
+  }
+
+  template <typename OFFSET>
+  uint32_t CompressedRTree<OFFSET>::ReadBits(const uint8_t *a_in, uint64_t a_bit, int a_bits) {
+    // Читаем побайтно: поправка занимает не больше четырех байт
+    uint32_t value = 0;
+    int done = 0;
+    while(done < a_bits)
+    {
+      int shift = static_cast<int> (a_bit & 7);
+      int take = std::min(8 - shift, a_bits - done);
+      uint32_t part = (static_cast<uint32_t> (a_in[a_bit >> 3]) >> shift) & ((1u << take) - 1);
+      value |= part << done;
+      done += take;
+      a_bit += static_cast<uint64_t> (take);
+    }
+    return value;
+  }
+
+  template <typename OFFSET>
+  RTree::Rect CompressedRTree<OFFSET>::Refine(const Node &a_node, uint32_t a_index, RTree::Rect a_rect) const {
+    const uint8_t* residuals = &m_residuals[a_node.m_residualOffset];
+    uint64_t bit = static_cast<uint64_t> (a_index) * 2 * dimensions * a_node.m_residualBits;
+
+    for(int axis = 0; axis < dimensions; ++axis, bit += a_node.m_residualBits)
+    {
+      a_rect.m_min[axis] = static_cast<int> (a_rect.m_min[axis] + static_cast<int64_t> (ReadBits(residuals, bit, a_node.m_residualBits)));
+    }
+    for(int axis = 0; axis < dimensions; ++axis, bit += a_node.m_residualBits)
+    {
+      a_rect.m_max[axis] = static_cast<int> (a_rect.m_max[axis] - static_cast<int64_t> (ReadBits(residuals, bit, a_node.m_residualBits)));
+    }
+    return a_rect;
+  }
+
+  template <typename OFFSET>
+  void CompressedRTree<OFFSET>::WriteVarint(uint64_t a_value, std::vector<uint8_t> &a_out) {
+    while(a_value >= 0x80)
+    {
+      a_out.push_back(static_cast<uint8_t> (a_value | 0x80));
+      a_value >>= 7;
+    }
+    a_out.push_back(static_cast<uint8_t> (a_value));
+  }
+
+  template <typename OFFSET>
+  uint64_t CompressedRTree<OFFSET>::ReadVarint(const uint8_t **a_in) {
+    uint64_t value = 0;
+    int shift = 0;
+    while(**a_in & 0x80)
+    {
+      value |= static_cast<uint64_t> (**a_in & 0x7f) << shift;
+      shift += 7;
+      ++*a_in;
+    }
+    value |= static_cast<uint64_t> (**a_in) << shift;
+    ++*a_in;
+    return value;
+  }
+
+  template <typename OFFSET>
+  bool CompressedRTree<OFFSET>::Search(uint32_t a_node, const RTree::Rect &a_frame, const RTree::Rect &a_rect, int &a_foundCount, bool (*a_resultCallback)(int, void *), void *a_context) const {
+    const Node& node = m_nodes[a_node];
+    const OFFSET* coords = &m_coords[static_cast<size_t> (node.m_rectSlot) * 2 * dimensions];
+
+    if(node.m_level > 0) // Это внутренний узел в дереве
+    {
+      for(uint32_t index = 0; index < node.m_count; ++index)
+      {
+        RTree::Rect child = Dequantize(coords + index * 2 * dimensions, a_frame);
+        if(Overlap(a_rect, child))
+        {
+          if(!Search(node.m_first + index, child, a_rect, a_foundCount, a_resultCallback, a_context))
+          {
+            return false;
+          }
+        }
+      }
+    }
+    else // Лист
+    {
+      const uint8_t* ids = &m_ids[node.m_idOffset];
+      int64_t id = 0;
+
+      for(uint32_t index = 0; index < node.m_count; ++index)
+      {
+        // Идентификаторы декодируются последовательно, даже если запись не подходит
+        uint64_t delta = ReadVarint(&ids);
+        id = (index == 0) ? static_cast<int64_t> (delta >> 1) ^ -static_cast<int64_t> (delta & 1)
+                          : id + static_cast<int64_t> (delta);
+
+        RTree::Rect rounded = Dequantize(coords + index * 2 * dimensions, a_frame);
+        if(!Overlap(a_rect, rounded))
+        {
+          continue;
+        }
+        // Уточняем по точной геометрии только кандидатов
+        if(node.m_residualBits > 0 && !Overlap(a_rect, Refine(node, index, rounded)))
+        {
+          continue;
+        }
+
+        ++a_foundCount;
+        if(a_resultCallback && !a_resultCallback(static_cast<int> (id), a_context))
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  template struct CompressedRTree<uint8_t>;
+  template struct CompressedRTree<uint16_t>;
+
+}  // namespace itis
@@ -0,0 +1,95 @@
+#include "durable_r_tree.hpp"
+
+#include <cstdio>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace itis {
+  uint64_t DurableChecksum(const void *a_data, size_t a_size) {
+    const unsigned char* bytes = static_cast<const unsigned char*> (a_data);
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t index = 0; index < a_size; ++index)
+    {
+      hash ^= bytes[index];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  bool DurableSync(std::FILE *a_file) {
+    if(std::fflush(a_file) != 0)
+    {
+      return false;
+    }
+#if defined(_WIN32)
+    return _commit(_fileno(a_file)) == 0;
+#else
+    return fsync(fileno(a_file)) == 0;
+#endif
+  }
+
+  bool DurableSeek(std::FILE *a_file, uint64_t a_offset) {
+#if defined(_WIN32)
+    return _fseeki64(a_file, static_cast<__int64> (a_offset), SEEK_SET) == 0;
+#else
+    return fseeko(a_file, static_cast<off_t> (a_offset), SEEK_SET) == 0;
+#endif
+  }
+
+  bool DurableSize(std::FILE *a_file, uint64_t &a_size) {
+#if defined(_WIN32)
+    if(_fseeki64(a_file, 0, SEEK_END) != 0)
+    {
+      return false;
+    }
+    __int64 size = _ftelli64(a_file);
+#else
+    if(fseeko(a_file, 0, SEEK_END) != 0)
+    {
+      return false;
+    }
+    off_t size = ftello(a_file);
+#endif
+    if(size < 0)
+    {
+      return false;
+    }
+    a_size = static_cast<uint64_t> (size);
+    return true;
+  }
+
+  bool DurableSyncDirectory(const std::string &a_path) {
+#if defined(_WIN32)
+    (void) a_path;
+    return true;
+#else
+    size_t slash = a_path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : a_path.substr(0, slash));
+    int descriptor = open(directory.c_str(), O_RDONLY);
+    if(descriptor < 0)
+    {
+      return false;
+    }
+    bool synced = fsync(descriptor) == 0;
+    close(descriptor);
+    return synced;
+#endif
+  }
+
+  bool DurableReplace(const std::string &a_from, const std::string &a_to) {
+#if defined(_WIN32)
+    // rename в Windows не заменяет существующий файл
+    std::remove(a_to.c_str());
+#endif
+    return std::rename(a_from.c_str(), a_to.c_str()) == 0 && DurableSyncDirectory(a_to);
+  }
+
+  // Сам DurableRTree - шаблон из заголовка; вариант для int собирается рядом с файловыми функциями выше
+  template struct DurableRTree<int>;
+
+}  // namespace itis
@@ -0,0 +1,9 @@
+#include "frozen_r_tree.hpp"
+
+namespace itis {
+
+  // Собираем оба вида листьев - с прямоугольниками и с точками, - чтобы ошибки в шаблоне ловились без бенчмарков
+  template struct FrozenRTree<int>;
+  template struct FrozenRTree<int, Point>;
+
+}  // namespace itis
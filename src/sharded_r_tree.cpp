@@ -0,0 +1,8 @@
+#include "sharded_r_tree.hpp"
+
+namespace itis {
+
+  // Пул потоков и блокировки шардов тоже в заголовке - компилируем их здесь для int
+  template struct ShardedRTree<int>;
+
+}  // namespace itis
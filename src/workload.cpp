@@ -0,0 +1,227 @@
+#include "workload.hpp"
+
+#include <charconv>
+#include <cstring>
+
+namespace itis {
+  namespace {
+    const char kMagic[4] = {'R', 'T', 'W', 'L'};
+
+    // Число полей записи: операция, id, m_min, m_max
+    constexpr int kFieldCount = 2 + 2 * dimensions;
+
+    // Размер буфера записи; одна строка CSV заведомо короче kMaxLine
+    constexpr size_t kBufferSize = 1 << 20;
+    constexpr size_t kMaxLine = 128;
+
+    bool IsOp(int a_value) {
+      return a_value == static_cast<int> (WorkloadOp::kInsert) || a_value == static_cast<int> (WorkloadOp::kRemove) ||
+             a_value == static_cast<int> (WorkloadOp::kSearch);
+    }
+  }  // namespace
+
+  WorkloadWriter::WorkloadWriter(const std::string &a_path, WorkloadFormat a_format)
+      : m_file(std::fopen(a_path.c_str(), "wb")), m_format(a_format), m_failed(false) {
+    m_buffer.reserve(kBufferSize);
+    if(m_file && m_format == WorkloadFormat::kBinary)
+    {
+      int32_t dims = dimensions;
+      m_buffer.insert(m_buffer.end(), kMagic, kMagic + sizeof(kMagic));
+      m_buffer.insert(m_buffer.end(), reinterpret_cast<const char*> (&dims), reinterpret_cast<const char*> (&dims) + sizeof(dims));
+    }
+  }
+
+  WorkloadWriter::~WorkloadWriter() {
+    Close();
+  }
+
+  void WorkloadWriter::Write(const WorkloadRecord &a_record) {
+    if(m_buffer.size() + kMaxLine > kBufferSize)
+    {
+      FlushBuffer();
+    }
+
+    if(m_format == WorkloadFormat::kBinary)
+    {
+      int32_t fields[kFieldCount];
+      fields[0] = static_cast<int32_t> (a_record.m_op);
+      fields[1] = a_record.m_id;
+      for(int axis = 0; axis < dimensions; ++axis)
+      {
+        fields[2 + axis] = a_record.m_rect.m_min[axis];
+        fields[2 + dimensions + axis] = a_record.m_rect.m_max[axis];
+      }
+      m_buffer.insert(m_buffer.end(), reinterpret_cast<const char*> (fields), reinterpret_cast<const char*> (fields) + sizeof(fields));
+      return;
+    }
+
+    // CSV: вставки пишутся без буквы операции, как в прежних наборах данных
+    char line[kMaxLine];
+    char* end = line + kMaxLine;
+    char* position = line;
+    if(a_record.m_op != WorkloadOp::kInsert)
+    {
+      *position++ = static_cast<char> (a_record.m_op);
+      *position++ = ',';
+    }
+    position = std::to_chars(position, end, a_record.m_id).ptr;
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      *position++ = ',';
+      position = std::to_chars(position, end, a_record.m_rect.m_min[axis]).ptr;
+    }
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      *position++ = ',';
+      position = std::to_chars(position, end, a_record.m_rect.m_max[axis]).ptr;
+    }
+    *position++ = '\n';
+    m_buffer.insert(m_buffer.end(), line, position);
+  }
+
+  bool WorkloadWriter::Close() {
+    if(!m_file)
+    {
+      return false;
+    }
+    FlushBuffer();
+    m_failed |= std::fclose(m_file) != 0;
+    m_file = nullptr;
+    return !m_failed;
+  }
+
+  void WorkloadWriter::FlushBuffer() {
+    if(!m_buffer.empty())
+    {
+      m_failed |= std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size();
+      m_buffer.clear();
+    }
+  }
+
+  WorkloadReader::WorkloadReader(const std::string &a_path)
+      : m_file(std::fopen(a_path.c_str(), "rb")), m_format(WorkloadFormat::kCsv), m_failed(false) {
+    if(!m_file)
+    {
+      return;
+    }
+
+    char magic[sizeof(kMagic)];
+    if(std::fread(magic, 1, sizeof(magic), m_file) == sizeof(magic) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0)
+    {
+      // Файл с другим числом измерений прочитать нельзя
+      int32_t dims = 0;
+      if(std::fread(&dims, sizeof(dims), 1, m_file) != 1 || dims != dimensions)
+      {
+        std::fclose(m_file);
+        m_file = nullptr;
+        return;
+      }
+      m_format = WorkloadFormat::kBinary;
+    }
+    else
+    {
+      std::rewind(m_file);
+    }
+  }
+
+  WorkloadReader::~WorkloadReader() {
+    if(m_file)
+    {
+      std::fclose(m_file);
+    }
+  }
+
+  bool WorkloadReader::Read(WorkloadRecord &a_record) {
+    if(!m_file || m_failed)
+    {
+      return false;
+    }
+    if(m_format == WorkloadFormat::kCsv)
+    {
+      return ReadCsv(a_record);
+    }
+
+    int32_t fields[kFieldCount];
+    size_t read = std::fread(fields, sizeof(int32_t), kFieldCount, m_file);
+    if(read != kFieldCount)
+    {
+      // Обрезанная запись в конце файла - ошибка, пустой остаток - конец
+      m_failed = read != 0;
+      return false;
+    }
+    if(!IsOp(fields[0]))
+    {
+      m_failed = true;
+      return false;
+    }
+    a_record.m_op = static_cast<WorkloadOp> (fields[0]);
+    a_record.m_id = fields[1];
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      a_record.m_rect.m_min[axis] = fields[2 + axis];
+      a_record.m_rect.m_max[axis] = fields[2 + dimensions + axis];
+    }
+    return true;
+  }
+
+  size_t WorkloadReader::Read(std::vector<WorkloadRecord> &a_records, size_t a_maxCount) {
+    size_t count = 0;
+    WorkloadRecord record;
+    while(count < a_maxCount && Read(record))
+    {
+      a_records.push_back(record);
+      ++count;
+    }
+    return count;
+  }
+
+  bool WorkloadReader::ReadCsv(WorkloadRecord &a_record) {
+    char line[kMaxLine];
+    do
+    {
+      if(!std::fgets(line, sizeof(line), m_file))
+      {
+        return false;
+      }
+    } while(line[0] == '\n' || line[0] == '\r');
+
+    const char* position = line;
+    const char* end = line + std::strlen(line);
+    a_record.m_op = WorkloadOp::kInsert;
+    if(position + 1 < end && position[1] == ',' && IsOp(position[0]))
+    {
+      a_record.m_op = static_cast<WorkloadOp> (position[0]);
+      position += 2;
+    }
+
+    int fields[kFieldCount - 1];
+    for(int index = 0; index < kFieldCount - 1; ++index)
+    {
+      if(index > 0)
+      {
+        if(position == end || *position != ',')
+        {
+          m_failed = true;
+          return false;
+        }
+        ++position;
+      }
+      auto result = std::from_chars(position, end, fields[index]);
+      if(result.ec != std::errc())
+      {
+        m_failed = true;
+        return false;
+      }
+      position = result.ptr;
+    }
+
+    a_record.m_id = fields[0];
+    for(int axis = 0; axis < dimensions; ++axis)
+    {
+      a_record.m_rect.m_min[axis] = fields[1 + axis];
+      a_record.m_rect.m_max[axis] = fields[1 + dimensions + axis];
+    }
+    return true;
+  }
+
+}  // namespace itis